@@ -1,6 +1,14 @@
 [BITS 16]
 [ORG 0x7C00]
 
+; The kernel lives in its own reserved area (FS_KERNEL_START and
+; FS_KERNEL_SECTORS in include/fs.h). build.sh passes the image size in
+; sectors; without it the whole area is read.
+%define KERNEL_LBA 256
+%ifndef KERNEL_SECTORS
+%define KERNEL_SECTORS 256
+%endif
+
 start:
     ; Save the boot drive ID (DL) passed by the BIOS
     mov [boot_drive_id], dl
@@ -18,11 +26,6 @@ start:
     mov si, loading_msg
     call print_string
 
-    ; Load kernel from disk into memory at 0x1000:0x0000 (Physical address 0x10000)
-    mov ax, 0x1000
-    mov es, ax
-    xor bx, bx
-
     ; Restore the drive ID from the saved variable
     mov dl, [boot_drive_id]
 
@@ -31,18 +34,31 @@ start:
     int 0x13
     jc error  ; If reset fails, show error
 
-    ; Read kernel sectors
-    ; Kernel is at sector 2 (sector 1 is bootloader, which is sector 0 in LBA)
-    mov ah, 0x02        ; Read sectors
-    mov al, 60          ; Number of sectors (29KB fits in 60 sectors)
-    mov ch, 0           ; Cylinder 0
-    mov cl, 2           ; Start from sector 2 (CHS sector numbering starts at 1)
-    mov dh, 0           ; Head 0
+    ; Load kernel from disk into memory at 0x1000:0x0000 (Physical address 0x10000)
+    ; LBA extended reads, 64 sectors (32 KB) at a time so that no read
+    ; crosses a 64 KB boundary or depends on the disk's geometry
+    mov di, KERNEL_SECTORS
+read_loop:
+    mov ax, di
+    cmp ax, 64
+    jbe .count_ok
+    mov ax, 64
+.count_ok:
+    mov [dap_count], ax
+    mov si, dap
+    mov ah, 0x42        ; Extended read
     mov dl, [boot_drive_id]
-
     int 0x13
     jc error            ; If error, jump to error handler
 
+    mov ax, [dap_count]
+    sub di, ax
+    add [dap_lba], ax   ; Next sectors...
+    shl ax, 5
+    add [dap_segment], ax ; ...go 512 bytes (32 paragraphs) per sector further
+    test di, di
+    jnz read_loop
+
     ; Print success message
     mov si, success_msg
     call print_string
@@ -190,6 +206,18 @@ gdt_descriptor:
 
 boot_drive_id db 0
 
+; Disk address packet for the extended reads
+dap:
+    db 0x10          ; Packet size
+    db 0
+dap_count:
+    dw 0             ; Sectors to read
+    dw 0x0000        ; Buffer offset
+dap_segment:
+    dw 0x1000        ; Buffer segment
+dap_lba:
+    dq KERNEL_LBA    ; First sector
+
 [BITS 32]
 protected_mode_start:
     ; Setup all segment registers with data segment selector
@@ -11,7 +11,9 @@ echo "    Done!"
 echo ""
 
 # Compiler flags
-CFLAGS="-m32 -Iinclude -ffreestanding -nostdlib -fno-pie -fno-pic -fno-stack-protector -O2"
+# No unwind tables: nothing in the kernel reads them, and they are a
+# quarter of the image
+CFLAGS="-m32 -Iinclude -ffreestanding -nostdlib -fno-pie -fno-pic -fno-stack-protector -fno-asynchronous-unwind-tables -O2"
 
 # Compile each module
 
@@ -47,6 +49,26 @@ echo "[7/12] Compiling fs.c..."
 gcc $CFLAGS -c src/fs.c -o fs.o
 if [ $? -ne 0 ]; then echo "Error!"; exit 1; fi
 
+echo "[7/12] Compiling pagecache.c..."
+gcc $CFLAGS -c src/pagecache.c -o pagecache.o
+if [ $? -ne 0 ]; then echo "Error!"; exit 1; fi
+
+echo "[7/12] Compiling vfs.c..."
+gcc $CFLAGS -c src/vfs.c -o vfs.o
+if [ $? -ne 0 ]; then echo "Error!"; exit 1; fi
+
+echo "[7/12] Compiling tmpfs.c..."
+gcc $CFLAGS -c src/tmpfs.c -o tmpfs.o
+if [ $? -ne 0 ]; then echo "Error!"; exit 1; fi
+
+echo "[7/12] Compiling procfs.c..."
+gcc $CFLAGS -c src/procfs.c -o procfs.o
+if [ $? -ne 0 ]; then echo "Error!"; exit 1; fi
+
+echo "[7/12] Compiling devfs.c..."
+gcc $CFLAGS -c src/devfs.c -o devfs.o
+if [ $? -ne 0 ]; then echo "Error!"; exit 1; fi
+
 echo "[8/12] Compiling text.c..."
 gcc $CFLAGS -c src/text.c -o text.o
 if [ $? -ne 0 ]; then echo "Error!"; exit 1; fi
@@ -78,7 +100,7 @@ if [ $? -ne 0 ]; then echo "Error!"; exit 1; fi
 
 echo "[14/12] Linking kernel..."
 ld -m elf_i386 -Ttext 0x10000 --oformat binary \
-   kernel.o string.o vga.o memory.o interrupt.o shell.o fs.o text.o console.o mouse.o ata.o math.o auth.o syscall.o\
+   kernel.o string.o vga.o memory.o interrupt.o shell.o fs.o vfs.o pagecache.o tmpfs.o procfs.o devfs.o text.o console.o mouse.o ata.o math.o auth.o syscall.o\
    -o kernel.bin -nostdlib -e _start
 if [ $? -ne 0 ]; then
     echo "Error: Linking failed!"
@@ -93,14 +115,15 @@ echo ""
 echo "Kernel size: $KERNEL_SIZE bytes ($KERNEL_SECTORS sectors)"
 echo ""
 
-# Check if kernel is too large
-if [ $KERNEL_SECTORS -gt 200 ]; then
-    echo "WARNING: Kernel is very large ($KERNEL_SECTORS sectors)"
-    echo "Consider increasing the filesystem start sector in fs.h"
+# The kernel must fit its reserved area (FS_KERNEL_SECTORS in include/fs.h)
+if [ $KERNEL_SECTORS -gt 256 ]; then
+    echo "Error: Kernel is too large ($KERNEL_SECTORS of 256 sectors)"
+    echo "Increase FS_KERNEL_SECTORS in include/fs.h"
+    exit 1
 fi
 
 echo "[15/12] Assembling bootloader..."
-nasm -f bin boot.asm -o boot.bin
+nasm -f bin -DKERNEL_SECTORS=$KERNEL_SECTORS boot.asm -o boot.bin
 if [ $? -ne 0 ]; then echo "Error!"; exit 1; fi
 
 echo "[16/12] Creating OS image..."
@@ -113,17 +136,25 @@ if [ $? -ne 0 ]; then echo "Error creating disk image!"; exit 1; fi
 dd if=boot.bin of=disk.img seek=0 count=1 bs=512 conv=notrunc status=none
 if [ $? -ne 0 ]; then echo "Error writing bootloader!"; exit 1; fi
 
-# Write the kernel starting at LBA Sector 1 (CHS Sector 2)
-# This corresponds to CHS: Cylinder 0, Head 0, Sector 2
-dd if=kernel.bin of=disk.img seek=1 bs=512 conv=notrunc status=none
+# Write the kernel to its reserved area at LBA 256 (FS_KERNEL_START)
+dd if=kernel.bin of=disk.img seek=256 bs=512 conv=notrunc status=none
 if [ $? -ne 0 ]; then echo "Error writing kernel!"; exit 1; fi
 
+# Pre-populate the filesystem from rootfs/ (otherwise the kernel formats at first boot)
+if [ -d rootfs ]; then
+    echo "[17/12] Populating filesystem from rootfs/..."
+    gcc -O2 -o mkpunixfs tools/mkpunixfs.c
+    if [ $? -ne 0 ]; then echo "Error building mkpunixfs!"; exit 1; fi
+    ./mkpunixfs build disk.img rootfs
+    if [ $? -ne 0 ]; then echo "Error populating filesystem!"; exit 1; fi
+fi
+
 echo ""
 echo "======================================"
 echo "Build complete!"
 echo "Kernel: $KERNEL_SIZE bytes ($KERNEL_SECTORS sectors)"
 echo "Bootloader: 512 bytes (1 sector)"
-echo "Filesystem starts at sector: $((KERNEL_SECTORS + 1))"
+echo "Kernel area: sectors 256-511; filesystem superblock at sector 61"
 echo "======================================"
 echo ""
 
@@ -12,9 +12,25 @@
 #define ATA_SR_DF 0x20 // Drive Write Fault
 #define ATA_SR_ERR 0x01 // Error
 
+// I/O counters since boot (exported through /proc/diskstats)
+typedef struct {
+    uint32_t reads;             // READ commands
+    uint32_t sectors_read;
+    uint32_t writes;            // WRITE commands
+    uint32_t sectors_written;
+    uint32_t flushes;
+    uint32_t errors;            // Commands that failed or timed out
+} ata_stats_t;
+
 // Public Interface
 void ata_init();
 
+/**
+ * @brief Returns the number of addressable sectors reported by IDENTIFY.
+ * @return Sector count, or 0 if the drive did not answer IDENTIFY.
+ */
+uint32_t ata_get_sector_count();
+
 /**
  * @brief Reads one or more sectors from the disk.
  * @param lba The starting Logical Block Address (28-bit).
@@ -25,7 +41,7 @@ void ata_init();
 int ata_read_sectors(uint32_t lba, uint8_t count, void* buffer);
 
 /**
- * @brief Writes one or more sectors to the disk.
+ * @brief Writes one or more sectors to the disk and flushes the drive cache.
  * @param lba The starting Logical Block Address (28-bit).
  * @param count The number of sectors to write (1 to 256).
  * @param buffer The source buffer.
@@ -33,4 +49,22 @@ int ata_read_sectors(uint32_t lba, uint8_t count, void* buffer);
  */
 int ata_write_sectors(uint32_t lba, uint8_t count, void* buffer);
 
+/**
+ * @brief Writes sectors without flushing the drive's write cache.
+ * The data is only durable after a later ata_flush().
+ * @return 0 on success, -1 on failure.
+ */
+int ata_write_sectors_noflush(uint32_t lba, uint8_t count, void* buffer);
+
+/**
+ * @brief Flushes the drive's write cache (FLUSH CACHE).
+ * @return 0 on success, -1 on failure.
+ */
+int ata_flush();
+
+/**
+ * @brief Copies the I/O counters.
+ */
+void ata_get_stats(ata_stats_t* out);
+
 #endif // ATA_H
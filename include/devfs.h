@@ -0,0 +1,56 @@
+// include/devfs.h - Device nodes (mounted at /dev)
+
+#ifndef DEVFS_H
+#define DEVFS_H
+
+#include "types.h"
+#include "fs.h"
+#include "vfs.h"
+
+// VFS tag of devfs node IDs; the low bits index the device table
+#define DEVFS_TAG               10
+#define DEVFS_ID_BASE           ((uint32_t)DEVFS_TAG << VFS_TAG_SHIFT)
+#define DEVFS_ROOT_ID           DEVFS_ID_BASE
+
+#define DEVFS_RAMDISK_KB        1024    // Size of /dev/ram0
+#define DEVFS_MAX_RUN           128     // Sectors per ATA command on /dev/hda
+
+/**
+ * @brief Sets up the device nodes. The RAM disk is allocated on its
+ * first write; until then it reads as zeros.
+ * @param name Name of the root directory (that of the mount point)
+ * @return 1 on success.
+ */
+int devfs_init(const char* name);
+
+/**
+ * @brief Returns the node for a devfs ID. Block devices report their
+ * capacity as the size; character devices report 0.
+ */
+fs_node_t* devfs_get_node(uint32_t id);
+
+/**
+ * @brief Finds a device in the devfs root.
+ * @return The device's ID, or 0 if not found.
+ */
+uint32_t devfs_lookup(uint32_t dir_id, const char* name, uint32_t len);
+
+/**
+ * @brief Reads from a device. Character devices ignore the offset and
+ * block until input arrives; block devices read at the byte offset.
+ * @return Number of bytes read (0 at the end of a block device), or -1.
+ */
+int devfs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count);
+
+/**
+ * @brief Writes to a device.
+ * @return Number of bytes written, or -1 if nothing could be written.
+ */
+int devfs_write(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count);
+
+/**
+ * @brief Reads one directory entry (cursor semantics as fs_readdir()).
+ */
+int devfs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out);
+
+#endif // DEVFS_H
@@ -3,38 +3,183 @@
 #include "types.h"
 
 // --- Constants ---
+#define FS_MAGIC            0xEF5342
+#define FS_JOURNAL_MAGIC    0x4A524E4C  // "JRNL"
+#define FS_ROOT_ID          1
+#define FS_REFS_ID          0   // Not a file: its data counts shared blocks
 #define FS_TYPE_FILE        0
 #define FS_TYPE_DIRECTORY   1
+#define FS_TYPE_CHAR_DEVICE 2   // devfs only; never stored on disk
+#define FS_TYPE_BLOCK_DEVICE 3
 #define FS_MAX_NAME         64
-#define FS_MAX_CHILDREN     16
+
+// --- Node flags ---
+#define FS_FLAG_INDEXED     0x01    // Directory block 0 is a hash index root
+
+// --- On-disk format version ---
+// v1: one 512-byte node per sector, file data in the node's padding.
+// v2: packed 128-byte inodes (4 per sector), file data in data blocks.
+// v3: inode and block bitmaps; table sizes derived from the disk size.
+// v4: directories hold (name, id, type) entries instead of child IDs.
+// v5: large directories carry a hashed index (v4 disks mount unchanged).
+// v6: metadata journal at LBA 190-255 (v4/v5 disks get an empty one).
+// v7: clones share data blocks; inode 0 holds one reference byte per
+//     sector (older disks have no shared blocks and mount unchanged).
+#define FS_VERSION          7
+#define FS_MIN_VERSION      4
 
 // --- CRITICAL FIX: Correct sector numbers ---
 // Disk Layout:
 // LBA 0: Bootloader (CHS Sector 1)
-// LBA 1-60: Kernel (CHS Sectors 2-61)
+// LBA 1-60: Unused (the kernel's old home; it outgrew it)
 // LBA 61: Filesystem Superblock (CHS Sector 62)
-// LBA 62+: Node Table (CHS Sector 63+)
+// LBA 62-189: v1 Node Table (only read when converting an old disk)
+// LBA 190-255: Metadata Journal (two alternating commit slots)
+// LBA 256-511: Kernel (loaded by boot.asm)
+// LBA 512+: Inode Bitmap, Block Bitmap, Inode Table, then the data blocks
+//           (region starts and sizes are recorded in the superblock; disks
+//           formatted before the kernel area have them from LBA 256 and
+//           are not mounted)
 #define FS_SUPERBLOCK_SECTOR    61  // Superblock at LBA 61
-#define FS_NODE_TABLE_START     62  // Node table starts at LBA 62
+#define FS_NODE_TABLE_START     62  // v1 node table starts at LBA 62
+#define FS_JOURNAL_START        190 // Journal slots start at LBA 190
+#define FS_KERNEL_START         256 // Kernel image starts at LBA 256
+#define FS_KERNEL_SECTORS       256 // Room for a 128 KB kernel image
+#define FS_LAYOUT_START         (FS_KERNEL_START + FS_KERNEL_SECTORS) // Bitmaps and inode table
 // -----------------------------------------------
 
+#define FS_SECTOR_SIZE          512
+#define FS_INODE_SIZE           128
+#define FS_INODES_PER_SECTOR    (FS_SECTOR_SIZE / FS_INODE_SIZE)
+#define FS_DIRECT_BLOCKS        7
+#define FS_PTRS_PER_BLOCK       (FS_SECTOR_SIZE / 4)
+#define FS_BITS_PER_SECTOR      (FS_SECTOR_SIZE * 8)
+#define FS_SECTORS_PER_INODE    8   // One inode per 4 KB of disk
+#define FS_JOURNAL_SLOT_SECTORS ((FS_KERNEL_START - FS_JOURNAL_START) / 2)
+#define FS_JOURNAL_MAX_BLOCKS   (FS_JOURNAL_SLOT_SECTORS - 1)
+#define FS_DX_MAX_LEVELS        3   // Index levels, including the root
+
 // --- Data Structures ---
 /**
  * @brief The Inode structure representing a file or directory.
- * Sized to fit comfortably within a 512-byte ATA sector.
- * (Approx 152 bytes used + padding).
+ * Exactly 128 bytes, so four inodes share one 512-byte ATA sector.
+ * File contents (and a directory's entries) live out-of-line in
+ * data blocks reached through direct[], indirect and double_indirect.
  */
 typedef struct fs_node {
     uint32_t id;
     uint32_t parent_id;
     uint8_t  type;              // FS_TYPE_FILE or FS_TYPE_DIRECTORY
-    char     name[FS_MAX_NAME]; // Fixed name buffer
+    uint8_t  flags;
+    uint16_t reserved;
     uint32_t size;              // Size in bytes
     uint32_t child_count;
-    uint32_t child_ids[FS_MAX_CHILDREN];
-    uint8_t  padding[300];      // Padding to ensure struct size ~512 bytes
+    char     name[FS_MAX_NAME]; // Fixed name buffer
+    uint32_t blocks;            // Data sectors owned by this node
+    uint32_t direct[FS_DIRECT_BLOCKS];
+    uint32_t indirect;          // Sector of FS_PTRS_PER_BLOCK block pointers
+    uint32_t double_indirect;   // Sector of pointers to indirect sectors
+    uint32_t spare;
 } fs_node_t;
 
+/**
+ * @brief On-disk directory entry (variable length, ext2 style).
+ * Records are 4-byte aligned and never cross a sector; rec_len reaches
+ * the next record and the last one runs to the end of the sector.
+ * id == 0 marks an unused record. The name is not NUL-terminated.
+ */
+typedef struct {
+    uint32_t id;
+    uint16_t rec_len;
+    uint8_t  name_len;
+    uint8_t  type;
+    char     name[FS_MAX_NAME - 1];
+} fs_disk_dirent_t;
+
+#define FS_DIRENT_HEADER        8
+#define FS_DIRENT_SIZE(len)     ((FS_DIRENT_HEADER + (len) + 3) & ~3)
+
+/**
+ * @brief Header of a directory index block, right after the unused
+ * record that covers the block. levels is only set in the root.
+ */
+typedef struct {
+    uint16_t count;
+    uint16_t limit;
+    uint8_t  levels;            // Index levels including the root
+    uint8_t  reserved[3];
+} fs_dx_header_t;
+
+/**
+ * @brief Index entry: names hashing to >= hash (up to the next entry)
+ * live under the directory-relative block.
+ */
+typedef struct {
+    uint32_t hash;
+    uint32_t block;
+} fs_dx_entry_t;
+
+// Index entries that fit in one block
+#define FS_DX_LIMIT ((FS_SECTOR_SIZE - FS_DIRENT_HEADER - sizeof(fs_dx_header_t)) / sizeof(fs_dx_entry_t))
+
+/**
+ * @brief Directory name hash (32-bit FNV-1a)
+ */
+static inline uint32_t fs_name_hash(const char* name, uint32_t len) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Journal slot descriptor, followed on disk by the count logged
+ * sectors. A slot is valid only if the checksum (over the sequence, the
+ * LBAs and the logged sectors) matches, so a torn commit is ignored.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t count;
+    uint32_t checksum;
+    uint32_t lba[FS_JOURNAL_MAX_BLOCKS];  // Home location of each sector
+    uint8_t  reserved[FS_SECTOR_SIZE - 16 - 4 * FS_JOURNAL_MAX_BLOCKS];
+} fs_journal_desc_t;
+
+/**
+ * @brief The Superblock (LBA 61). The first five fields match v1.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t root_id;
+    uint32_t next_free_id;      // Next-fit hint into the inode bitmap
+    uint32_t total_nodes;
+    uint32_t used_sectors;
+    uint32_t version;           // 0 on v1 disks (was reserved space)
+    uint32_t inode_table_start;
+    uint32_t inode_table_sectors;
+    uint32_t max_nodes;
+    uint32_t data_start;        // First data block sector
+    uint32_t total_sectors;
+    uint32_t next_free_lba;     // Next-fit hint into the block bitmap
+    uint32_t inode_bitmap_start;
+    uint32_t inode_bitmap_sectors;
+    uint32_t block_bitmap_start;
+    uint32_t block_bitmap_sectors;
+    uint8_t  reserved[448];
+} superblock_t;
+
+/**
+ * @brief A directory entry as returned by fs_readdir().
+ */
+typedef struct {
+    uint32_t id;
+    uint8_t  type;
+    char     name[FS_MAX_NAME];
+} fs_dirent_t;
+
 // --- Global State ---
 // These allow the shell to know "where" it is globally
 extern uint32_t fs_root_id;
@@ -44,6 +189,7 @@ extern uint32_t fs_current_dir_id;
 /**
  * @brief Initializes the file system.
  * Reads the Superblock from Disk. If invalid, formats the drive.
+ * A v1 disk is converted to the current format in place.
  */
 void fs_init();
 
@@ -71,12 +217,18 @@ int fs_update_node(fs_node_t* node);
  */
 uint32_t fs_find_node_local_id(uint32_t parent_id, char* name);
 
+/**
+ * @brief Same lookup for a name that need not be NUL-terminated.
+ */
+uint32_t fs_lookup(uint32_t parent_id, const char* name, uint32_t len);
+
 /**
  * @brief Creates a new node (File or Directory).
- * Automatically persists changes to disk.
+ * Automatically persists changes to disk. Names must be 1 to
+ * FS_MAX_NAME - 1 characters long.
  * @return 1 on success, 0 on failure.
  */
-int fs_create_node(uint32_t parent_id, char* name, uint8_t type);
+int fs_create_node(uint32_t parent_id, const char* name, uint8_t type);
 
 /**
  * @brief Deletes a node by ID.
@@ -85,6 +237,45 @@ int fs_create_node(uint32_t parent_id, char* name, uint8_t type);
  */
 int fs_delete_node(uint32_t id);
 
+/**
+ * @brief Reads file contents starting at a byte offset.
+ * @return Number of bytes read (0 at end of file), or -1 on error.
+ */
+int fs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count);
+
+/**
+ * @brief Writes file contents at a byte offset, growing the file as needed.
+ * Allocates data blocks on demand and persists the node. Only node->id
+ * is used: callers that need the new size fetch the node again.
+ * @return Number of bytes written, or -1 on error.
+ */
+int fs_write(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count);
+
+/**
+ * @brief Copies file contents inside the kernel, block to block.
+ * Sector-aligned ranges move in multi-sector transfers that bypass the
+ * cache; anything else goes through it. Overlapping ranges of the same
+ * file are refused. The nodes are read, never written: callers that
+ * need dst's new size fetch the node again.
+ * @return Number of bytes copied (0 at end of src), or -1 on error.
+ */
+int fs_copy_range(const fs_node_t* src, uint32_t src_off, const fs_node_t* dst, uint32_t dst_off, uint32_t count);
+
+/**
+ * @brief Clones a file, or a directory with everything below it, as
+ * name in parent_id. File data is shared, not copied; a shared block is
+ * copied the first time either side writes to it.
+ * @return 1 on success, 0 on failure (a partial clone may remain).
+ */
+int fs_clone(uint32_t src_id, uint32_t parent_id, const char* name);
+
+/**
+ * @brief Reads one directory entry.
+ * @param cursor Position in the directory; start at 0, advanced on success.
+ * @return 1 if an entry was returned, 0 at the end of the directory.
+ */
+int fs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out);
+
 /**
  * @brief Gets current disk usage statistics.
  * @param total_kb Pointer to store total disk space in KB
@@ -95,14 +286,60 @@ void fs_get_disk_stats(uint32_t* total_kb, uint32_t* used_kb, uint32_t* free_kb)
 
 /**
  * @brief Gets cache statistics for monitoring performance.
- * @param cache_size Total cache size
- * @param cached_nodes Number of nodes currently in cache
- * @param dirty_nodes Number of nodes pending write-back
+ * @param cache_size Total cache size (in sectors)
+ * @param cached_nodes Number of sectors currently in cache
+ * @param dirty_nodes Number of sectors pending write-back
  */
 void fs_get_cache_stats(uint32_t* cache_size, uint32_t* cached_nodes, uint32_t* dirty_nodes);
 
 /**
- * @brief Flushes all dirty cache entries to disk.
+ * @brief Path lookup cache counters since boot.
+ */
+void fs_get_dcache_stats(uint32_t* hits, uint32_t* misses);
+
+/**
+ * @brief Starts a consistency check of the mounted filesystem.
+ * The check does nothing by itself; drive it with fs_check_step().
+ * @param verbose 1 = print progress every 10%
+ * @return 1 if a check is running, 0 if it could not be started
+ */
+int fs_check_start(int verbose);
+
+/**
+ * @brief Does one slice of the running check (at most one large read of
+ * the inode table). A change to the filesystem between slices restarts
+ * the check. Problems and the final summary are printed.
+ * @return 1 while work remains, 0 once no check is running
+ */
+int fs_check_step();
+
+/**
+ * @brief Reports how far the running check has got.
+ * @return 1 if a check is running, 0 otherwise
+ */
+int fs_check_status(uint32_t* percent);
+
+/**
+ * @brief Commits the running journal group, if it holds anything.
+ * Operations are otherwise committed in batches.
+ */
+void fs_commit();
+
+/**
+ * @brief Makes one file durable. File data already went to its blocks
+ * when written; what can remain is the drive's write cache and the
+ * running journal group.
+ * @param datasync 0 (fsync): commit the group if it holds anything, so
+ * a new file's directory entry is durable too. 1 (fdatasync): commit
+ * only if the group holds the file's inode (its size or block map
+ * changed); otherwise flushing the drive's cache is enough.
+ * @return 0 on success, -1 on a device error.
+ */
+int fs_sync_node(uint32_t id, int datasync);
+
+/**
+ * @brief Commits the running journal group and flushes all dirty cache
+ * entries to disk.
  * Call this periodically or before shutdown to ensure data persistence.
  */
 void fs_sync();
@@ -26,6 +26,15 @@ struct idt_ptr {
 void idt_init();
 void pic_init();
 
+// Times each IDT vector has fired; handlers bump their own entry
+extern volatile uint32_t interrupt_counts[256];
+
+/**
+ * @brief Returns the name of the handler installed on a vector.
+ * @return The name, or 0 if the vector has no handler.
+ */
+const char* interrupt_get_name(int vector);
+
 // Keyboard
 #define KEYBOARD_BUFFER_SIZE 256
 
@@ -0,0 +1,54 @@
+// include/pagecache.h - File data page cache and mmap support
+
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include "types.h"
+#include "fs.h"
+
+// Pages of file data kept in RAM (mapped pages count against this)
+#define PCACHE_PAGES 64
+
+/**
+ * @brief Reads file contents through the page cache.
+ * Falls back to an uncached read when no page can be cached.
+ * @return Number of bytes read (0 at end of file), or -1 on error.
+ */
+int pcache_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count);
+
+/**
+ * @brief Maps part of a file: returns the cached pages themselves.
+ * The pages are physically contiguous and stay cached until unmapped.
+ * Mapping the same range again returns the same address. Writes through
+ * vfs_write() show up in the mapping; stores into the mapping are not
+ * written back to the file.
+ * @param offset Start of the range, a multiple of PAGE_SIZE
+ * @return Address of the mapping, or 0 on failure.
+ */
+void* pcache_map(uint32_t node_id, uint32_t offset, uint32_t length);
+
+/**
+ * @brief Drops a mapping made by pcache_map().
+ * @return 0 on success, -1 if addr is not mapped.
+ */
+int pcache_unmap(void* addr, uint32_t length);
+
+/**
+ * @brief Copies freshly written file data into any cached pages.
+ * Called for every write: by cached filesystems themselves, by the VFS
+ * for the others.
+ */
+void pcache_update(uint32_t node_id, uint32_t offset, const void* buf, uint32_t count);
+
+/**
+ * @brief Drops a deleted file's pages. Mapped pages stay readable until
+ * they are unmapped.
+ */
+void pcache_forget(uint32_t node_id);
+
+/**
+ * @brief Page cache statistics since boot.
+ */
+void pcache_get_stats(uint32_t* cached, uint32_t* mapped, uint32_t* hits, uint32_t* misses);
+
+#endif // PAGECACHE_H
@@ -0,0 +1,46 @@
+// include/procfs.h - Kernel statistics as files (mounted at /proc)
+
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include "types.h"
+#include "fs.h"
+#include "vfs.h"
+
+// VFS tag of procfs node IDs; the low bits index the file table
+#define PROCFS_TAG              9
+#define PROCFS_ID_BASE          ((uint32_t)PROCFS_TAG << VFS_TAG_SHIFT)
+#define PROCFS_ROOT_ID          PROCFS_ID_BASE
+
+/**
+ * @brief Sets up the procfs nodes and the buffer files are generated in.
+ * @param name Name of the root directory (that of the mount point)
+ * @return 1 on success, 0 if the buffer could not be allocated.
+ */
+int procfs_init(const char* name);
+
+/**
+ * @brief Returns the node for a procfs ID. Files report size 0: their
+ * contents do not exist until they are read.
+ */
+fs_node_t* procfs_get_node(uint32_t id);
+
+/**
+ * @brief Finds a file in the procfs root.
+ * @return The file's ID, or 0 if not found.
+ */
+uint32_t procfs_lookup(uint32_t dir_id, const char* name, uint32_t len);
+
+/**
+ * @brief Reads a file, generating it from the kernel counters. A read at
+ * offset 0 takes a fresh snapshot; later offsets continue the same one.
+ * @return Number of bytes read (0 at end of file), or -1 on error.
+ */
+int procfs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count);
+
+/**
+ * @brief Reads one directory entry (cursor semantics as fs_readdir()).
+ */
+int procfs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out);
+
+#endif // PROCFS_H
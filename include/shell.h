@@ -20,7 +20,7 @@ void shell_run();
 void read_line_with_display(char* buffer, int max_len);
 
 // Command functions
-void cmd_ls();
+void cmd_ls(char* args);
 void cmd_pwd();
 void cmd_cd(char* path);
 void cmd_mkdir(char* path);
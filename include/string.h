@@ -8,6 +8,7 @@
 // Memory functions
 void* memset(void* s, int c, size_t n);
 void* memcpy(void* dest, const void* src, size_t n);
+int memcmp(const void* s1, const void* s2, size_t n);
 // String functions
 int strcmp(const char* str1, const char* str2);
 void strcpy(char* dest, const char* src);
@@ -12,6 +12,75 @@ struct dirent {
     char     d_name[64];      // Filename
 };
 
+// File metadata (sys_stat, sys_fstatat, sys_getdents_plus)
+struct stat {
+    uint32_t st_ino;          // Inode number
+    uint32_t st_parent;       // Inode of the containing directory
+    uint32_t st_size;         // Size in bytes
+    uint32_t st_blocks;       // Allocated space in 512-byte units
+    uint32_t st_nchildren;    // Entry count of a directory
+    uint8_t  st_type;         // File type
+    uint8_t  st_flags;        // Filesystem node flags
+    uint16_t st_reserved;
+};
+
+// Directory entry with its metadata (sys_getdents_plus)
+struct dirent_plus {
+    struct stat d_stat;
+    char        d_name[64];
+};
+
+// One segment of a readv/writev buffer list
+struct iovec {
+    void*    iov_base;
+    uint32_t iov_len;
+};
+#define IOV_MAX 16              // Segments per call
+
+// --- I/O ring (sys_io_setup, sys_io_enter) ---
+// Both rings live in the program's memory. Indices run freely and are
+// taken modulo the ring size; each side only advances its own: the
+// program sq_tail and cq_head, the kernel sq_head and cq_tail.
+#define IORING_ENTRIES      32                      // Submission slots
+#define IORING_CQ_ENTRIES   (2 * IORING_ENTRIES)    // Completion slots
+
+#define IORING_OP_NOP       0
+#define IORING_OP_READ      1
+#define IORING_OP_WRITE     2
+#define IORING_OP_OPENAT    3       // fd = directory (or AT_FDCWD), addr = path, len = flags
+#define IORING_OP_FSYNC     4
+#define IORING_OP_CLOSE     5
+
+#define IORING_OFF_CUR          0xFFFFFFFF  // off: at the file offset, advancing it
+#define IORING_FSYNC_DATASYNC   0x01        // flags of IORING_OP_FSYNC
+
+// One queued operation
+struct io_uring_sqe {
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t reserved;
+    int32_t  fd;
+    uint32_t off;             // File offset, or IORING_OFF_CUR
+    void*    addr;            // Buffer (or path)
+    uint32_t len;             // Byte count (or open flags)
+    uint32_t user_data;       // Handed back in the completion
+};
+
+// One finished operation
+struct io_uring_cqe {
+    uint32_t user_data;
+    int32_t  res;             // What the matching syscall would return
+};
+
+struct io_uring {
+    volatile uint32_t sq_head;      // Next entry the kernel runs; slots before it are free
+    volatile uint32_t sq_tail;      // Next slot the program fills
+    volatile uint32_t cq_head;      // Next completion the program reaps
+    volatile uint32_t cq_tail;      // Next slot the kernel fills
+    struct io_uring_sqe sqes[IORING_ENTRIES];
+    struct io_uring_cqe cqes[IORING_CQ_ENTRIES];
+};
+
 // System call numbers (for reference)
 #define SYS_READ         0
 #define SYS_WRITE        1
@@ -30,6 +99,26 @@ struct dirent {
 #define SYS_FREE         14
 #define SYS_PRINT        15
 #define SYS_CREATE_FILE  16
+#define SYS_MMAP         17
+#define SYS_MUNMAP       18
+#define SYS_COPY_FILE_RANGE 19
+#define SYS_REFLINK      20
+#define SYS_LSEEK        21
+#define SYS_PREAD        22
+#define SYS_PWRITE       23
+#define SYS_READV        24
+#define SYS_WRITEV       25
+#define SYS_GETDENTS_PLUS 26
+#define SYS_GETDENTS_FD  27
+#define SYS_GETDENTS_PLUS_FD 28
+#define SYS_OPENAT       29
+#define SYS_MKDIRAT      30
+#define SYS_FSTATAT      31
+#define SYS_FSYNC        32
+#define SYS_FDATASYNC    33
+#define SYS_IO_SETUP     34
+#define SYS_IO_ENTER     35
+#define SYS_COUNT        36     // One past the highest number
 
 // Open flags
 #define O_RDONLY  0x00
@@ -37,12 +126,52 @@ struct dirent {
 #define O_RDWR    0x02
 #define O_CREAT   0x04
 
+// dirfd of the *at() calls meaning the working directory
+#define AT_FDCWD  (-100)
+
+// lseek whence
+#define SEEK_SET  0
+#define SEEK_CUR  1
+#define SEEK_END  2
+
 // Kernel-side functions
 void syscall_init();
-void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
+uint32_t syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
                      uint32_t edx, uint32_t esi, uint32_t edi);
 extern void syscall_interrupt_wrapper();
 
+/**
+ * @brief Writes out the data buffered in every open file descriptor.
+ * The shell calls this before each commit, so a command's writes are
+ * on disk once the prompt returns.
+ */
+void syscall_flush_all();
+
+/**
+ * @brief Detaches the open fds of a deleted node and drops their
+ * buffered writes, which would otherwise land in whatever node reuses
+ * the ID. Later calls on those fds fail.
+ */
+void syscall_forget_node(uint32_t node_id);
+
+/**
+ * @brief Unregisters the I/O ring, dropping entries it still holds. The
+ * shell calls this when a command returns, as the ring and the buffers
+ * its entries point to may have lived on the command's stack.
+ */
+void syscall_io_release();
+
+/**
+ * @brief Per-syscall call counters (/proc/syscalls).
+ * @return The count, or 0 for numbers past SYS_COUNT.
+ */
+uint32_t syscall_get_count(uint32_t num);
+
+/**
+ * @brief Returns the name of a syscall, or 0 for an unused number.
+ */
+const char* syscall_get_name(uint32_t num);
+
 // User-space system call wrappers
 // These functions can be called from user programs
 
@@ -208,4 +337,349 @@ static inline int sys_getdents(const char* path, struct dirent* buf, int count)
     return ret;
 }
 
+static inline int sys_stat(const char* path, struct stat* st) {
+    int ret;
+    __asm__ volatile(
+        "mov $10, %%eax\n"      // SYS_STAT
+        "mov %1, %%ebx\n"       // path
+        "mov %2, %%ecx\n"       // st
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "r"(path), "r"(st)
+        : "eax", "ebx", "ecx"
+    );
+    return ret;
+}
+
+// Like sys_getdents, with each entry's metadata filled in: a listing
+// with sizes costs one call per directory instead of one per file.
+static inline int sys_getdents_plus(const char* path, struct dirent_plus* buf, int count) {
+    int ret;
+    __asm__ volatile(
+        "mov $26, %%eax\n"      // SYS_GETDENTS_PLUS
+        "mov %1, %%ebx\n"       // path
+        "mov %2, %%ecx\n"       // buf
+        "mov %3, %%edx\n"       // count
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(path), "g"(buf), "g"(count)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+// Reads the next entries of a directory opened with sys_open. The fd
+// keeps the position, so a large directory is read in batches until
+// the call returns 0; sys_lseek(fd, 0, SEEK_SET) starts over.
+static inline int sys_getdents_fd(int fd, struct dirent* buf, int count) {
+    int ret;
+    __asm__ volatile(
+        "mov $27, %%eax\n"      // SYS_GETDENTS_FD
+        "mov %1, %%ebx\n"       // fd
+        "mov %2, %%ecx\n"       // buf
+        "mov %3, %%edx\n"       // count
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(fd), "g"(buf), "g"(count)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+// sys_getdents_fd with each entry's metadata, as sys_getdents_plus.
+static inline int sys_getdents_plus_fd(int fd, struct dirent_plus* buf, int count) {
+    int ret;
+    __asm__ volatile(
+        "mov $28, %%eax\n"      // SYS_GETDENTS_PLUS_FD
+        "mov %1, %%ebx\n"       // fd
+        "mov %2, %%ecx\n"       // buf
+        "mov %3, %%edx\n"       // count
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(fd), "g"(buf), "g"(count)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+// Maps length bytes of an open file, starting at a page-aligned offset.
+// Returns the address of the file's cached pages (read-only by
+// convention: stores are not written back), or 0 on failure.
+static inline void* sys_mmap(int fd, uint32_t length, uint32_t offset) {
+    void* ret;
+    __asm__ volatile(
+        "mov $17, %%eax\n"      // SYS_MMAP
+        "mov %1, %%ebx\n"       // fd
+        "mov %2, %%ecx\n"       // length
+        "mov %3, %%edx\n"       // offset
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "r"(fd), "r"(length), "r"(offset)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+static inline int sys_munmap(void* addr, uint32_t length) {
+    int ret;
+    __asm__ volatile(
+        "mov $18, %%eax\n"      // SYS_MUNMAP
+        "mov %1, %%ebx\n"       // addr
+        "mov %2, %%ecx\n"       // length
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "r"(addr), "r"(length)
+        : "eax", "ebx", "ecx"
+    );
+    return ret;
+}
+
+// Copies up to count bytes between two open files inside the kernel,
+// from and to their current offsets (both advance). Returns bytes copied.
+static inline int sys_copy_file_range(int fd_in, int fd_out, uint32_t count) {
+    int ret;
+    __asm__ volatile(
+        "mov $19, %%eax\n"      // SYS_COPY_FILE_RANGE
+        "mov %1, %%ebx\n"       // fd_in
+        "mov %2, %%ecx\n"       // fd_out
+        "mov %3, %%edx\n"       // count
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "r"(fd_in), "r"(fd_out), "r"(count)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+// Clones a file or a whole directory tree as name (a path relative to
+// the current directory). Data blocks are shared until either copy writes to them.
+static inline int sys_reflink(const char* src, const char* name) {
+    int ret;
+    __asm__ volatile(
+        "mov $20, %%eax\n"      // SYS_REFLINK
+        "mov %1, %%ebx\n"       // src
+        "mov %2, %%ecx\n"       // name
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "r"(src), "r"(name)
+        : "eax", "ebx", "ecx"
+    );
+    return ret;
+}
+
+// Moves the offset of an open file (SEEK_SET, SEEK_CUR or SEEK_END);
+// seeking past the end is allowed. A directory fd only moves back to 0
+// or stays at the position getdents left. Returns the new offset, or -1.
+static inline int sys_lseek(int fd, int offset, int whence) {
+    int ret;
+    __asm__ volatile(
+        "mov $21, %%eax\n"      // SYS_LSEEK
+        "mov %1, %%ebx\n"       // fd
+        "mov %2, %%ecx\n"       // offset
+        "mov %3, %%edx\n"       // whence
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(fd), "g"(offset), "g"(whence)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+// Reads at an explicit offset; the file's own offset does not move.
+static inline int sys_pread(int fd, void* buf, uint32_t count, uint32_t offset) {
+    int ret;
+    __asm__ volatile(
+        "mov $22, %%eax\n"      // SYS_PREAD
+        "mov %1, %%ebx\n"       // fd
+        "mov %2, %%ecx\n"       // buf
+        "mov %3, %%edx\n"       // count
+        "mov %4, %%esi\n"       // offset
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(fd), "g"(buf), "g"(count), "g"(offset)
+        : "eax", "ebx", "ecx", "edx", "esi"
+    );
+    return ret;
+}
+
+// Writes at an explicit offset; the file's own offset does not move.
+static inline int sys_pwrite(int fd, const void* buf, uint32_t count, uint32_t offset) {
+    int ret;
+    __asm__ volatile(
+        "mov $23, %%eax\n"      // SYS_PWRITE
+        "mov %1, %%ebx\n"       // fd
+        "mov %2, %%ecx\n"       // buf
+        "mov %3, %%edx\n"       // count
+        "mov %4, %%esi\n"       // offset
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(fd), "g"(buf), "g"(count), "g"(offset)
+        : "eax", "ebx", "ecx", "edx", "esi"
+    );
+    return ret;
+}
+
+// Reads into several buffers in turn, from the file's offset. Returns
+// the total read (short at end of file), or -1.
+static inline int sys_readv(int fd, const struct iovec* iov, int iovcnt) {
+    int ret;
+    __asm__ volatile(
+        "mov $24, %%eax\n"      // SYS_READV
+        "mov %1, %%ebx\n"       // fd
+        "mov %2, %%ecx\n"       // iov
+        "mov %3, %%edx\n"       // iovcnt
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(fd), "g"(iov), "g"(iovcnt)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+// Writes several buffers as one contiguous write at the file's offset
+// (a single filesystem update for up to 64 KB). Returns the total written.
+static inline int sys_writev(int fd, const struct iovec* iov, int iovcnt) {
+    int ret;
+    __asm__ volatile(
+        "mov $25, %%eax\n"      // SYS_WRITEV
+        "mov %1, %%ebx\n"       // fd
+        "mov %2, %%ecx\n"       // iov
+        "mov %3, %%edx\n"       // iovcnt
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(fd), "g"(iov), "g"(iovcnt)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+// Opens a path relative to the directory open on dirfd (or AT_FDCWD).
+// With O_CREAT a missing file is created. A deep directory opened once
+// saves walking its path again for every file under it.
+static inline int sys_openat(int dirfd, const char* path, int flags) {
+    int ret;
+    __asm__ volatile(
+        "mov $29, %%eax\n"      // SYS_OPENAT
+        "mov %1, %%ebx\n"       // dirfd
+        "mov %2, %%ecx\n"       // path
+        "mov %3, %%edx\n"       // flags
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(dirfd), "g"(path), "g"(flags)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+static inline int sys_mkdirat(int dirfd, const char* path) {
+    int ret;
+    __asm__ volatile(
+        "mov $30, %%eax\n"      // SYS_MKDIRAT
+        "mov %1, %%ebx\n"       // dirfd
+        "mov %2, %%ecx\n"       // path
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(dirfd), "g"(path)
+        : "eax", "ebx", "ecx"
+    );
+    return ret;
+}
+
+static inline int sys_fstatat(int dirfd, const char* path, struct stat* st) {
+    int ret;
+    __asm__ volatile(
+        "mov $31, %%eax\n"      // SYS_FSTATAT
+        "mov %1, %%ebx\n"       // dirfd
+        "mov %2, %%ecx\n"       // path
+        "mov %3, %%edx\n"       // st
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(dirfd), "g"(path), "g"(st)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+// Returns once the file's data and metadata written so far are on the
+// disk. Other files keep their write-back buffering.
+static inline int sys_fsync(int fd) {
+    int ret;
+    __asm__ volatile(
+        "mov $32, %%eax\n"      // SYS_FSYNC
+        "mov %1, %%ebx\n"       // fd
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(fd)
+        : "eax", "ebx"
+    );
+    return ret;
+}
+
+// Like sys_fsync, but skips the metadata commit unless the file's size
+// or layout changed: an overwrite in place costs one cache flush.
+static inline int sys_fdatasync(int fd) {
+    int ret;
+    __asm__ volatile(
+        "mov $33, %%eax\n"      // SYS_FDATASYNC
+        "mov %1, %%ebx\n"       // fd
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(fd)
+        : "eax", "ebx"
+    );
+    return ret;
+}
+
+// Registers r as the I/O ring and clears it; 0 unregisters. Entries
+// still pending in the previous ring run first. The registration ends
+// when the shell command returns.
+static inline int sys_io_setup(struct io_uring* r) {
+    int ret;
+    __asm__ volatile(
+        "mov $34, %%eax\n"      // SYS_IO_SETUP
+        "mov %1, %%ebx\n"       // r
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(r)
+        : "eax", "ebx"
+    );
+    return ret;
+}
+
+// Submits up to to_submit queued entries in one call and runs every
+// submitted entry the completion ring has room for. Completions are read
+// from the ring, with no syscall. Returns the number of entries submitted.
+static inline int sys_io_enter(uint32_t to_submit) {
+    int ret;
+    __asm__ volatile(
+        "mov $35, %%eax\n"      // SYS_IO_ENTER
+        "mov %1, %%ebx\n"       // to_submit
+        "int $0x80\n"
+        "mov %%eax, %0\n"
+        : "=r"(ret)
+        : "g"(to_submit)
+        : "eax", "ebx"
+    );
+    return ret;
+}
+
 #endif // SYSCALL_H
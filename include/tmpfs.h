@@ -0,0 +1,76 @@
+// include/tmpfs.h - RAM-backed filesystem (mounted at /tmp)
+
+#ifndef TMPFS_H
+#define TMPFS_H
+
+#include "types.h"
+#include "fs.h"
+#include "vfs.h"
+
+// VFS tag of tmpfs node IDs
+#define TMPFS_TAG               8
+#define TMPFS_ID_BASE           ((uint32_t)TMPFS_TAG << VFS_TAG_SHIFT)
+#define TMPFS_ROOT_ID           TMPFS_ID_BASE
+
+#define TMPFS_MAX_NODES         1024
+#define TMPFS_DEFAULT_LIMIT_KB  4096    // Data pages, pointer pages included
+
+/**
+ * @brief Creates an empty tmpfs, dropping the contents of any earlier one.
+ * @param name Name of the root directory (that of the mount point)
+ * @return 1 on success, 0 if the node table could not be allocated.
+ */
+int tmpfs_init(const char* name, uint32_t limit_kb);
+
+/**
+ * @brief Returns the live node for a tmpfs ID, or 0 if it is free.
+ * There is nothing to write back: the node is the only copy.
+ */
+fs_node_t* tmpfs_get_node(uint32_t id);
+
+/**
+ * @brief Finds a child of a tmpfs directory.
+ * @return The child's ID, or 0 if not found.
+ */
+uint32_t tmpfs_lookup(uint32_t dir_id, const char* name, uint32_t len);
+
+/**
+ * @brief Creates a file or directory.
+ * @return 1 on success, 0 on failure (duplicate name, no free node).
+ */
+int tmpfs_create(uint32_t parent_id, const char* name, uint8_t type);
+
+/**
+ * @brief Deletes a node and frees its pages. The root cannot be deleted.
+ * @return 1 on success, 0 if missing or a non-empty directory.
+ */
+int tmpfs_delete(uint32_t id);
+
+/**
+ * @brief Reads file contents; unwritten ranges read as zeros.
+ * @return Number of bytes read (0 at end of file), or -1 on error.
+ */
+int tmpfs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count);
+
+/**
+ * @brief Writes file contents, allocating pages up to the size limit.
+ * @return Number of bytes written, or -1 if nothing could be written.
+ */
+int tmpfs_write(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count);
+
+/**
+ * @brief Reads one directory entry (cursor semantics as fs_readdir()).
+ */
+int tmpfs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out);
+
+/**
+ * @brief Usage against the limits set by tmpfs_init().
+ */
+void tmpfs_get_stats(uint32_t* nodes_used, uint32_t* max_nodes, uint32_t* used_kb, uint32_t* limit_kb);
+
+/**
+ * @brief Space in fs_get_disk_stats() terms: the limit is the total.
+ */
+void tmpfs_get_space(uint32_t* total_kb, uint32_t* used_kb, uint32_t* free_kb);
+
+#endif // TMPFS_H
@@ -0,0 +1,145 @@
+// include/vfs.h - Virtual filesystem switch and mount table
+
+#ifndef VFS_H
+#define VFS_H
+
+#include "types.h"
+#include "fs.h"
+
+// Node IDs are global: the top bits pick the filesystem type that owns
+// the node (0 = the disk), so routing a call is one table lookup.
+#define VFS_TAG_SHIFT       28
+#define VFS_TAG(id)         ((id) >> VFS_TAG_SHIFT)
+#define VFS_MAX_TAGS        16
+#define VFS_MAX_MOUNTS      8
+#define VFS_MAX_PATH        32
+
+// --- Filesystem type flags ---
+#define VFS_CACHED          0x01    // Reads go through the page cache, which
+                                    // the filesystem keeps up to date itself
+
+/**
+ * @brief Operations of one filesystem type. The signatures match the
+ * disk filesystem's public API, so its table holds those functions as
+ * they are. copy_range, clone, get_space and sync may be 0 (sync: the
+ * filesystem has nothing to make durable).
+ */
+typedef struct vfs_ops {
+    const char* name;
+    uint32_t    flags;
+    uint32_t    block_size;     // Bytes per unit of fs_node_t.blocks (0 = none)
+    fs_node_t*  (*get_node)(uint32_t id);
+    uint32_t    (*lookup)(uint32_t dir_id, const char* name, uint32_t len);
+    int         (*create)(uint32_t parent_id, const char* name, uint8_t type);
+    int         (*remove)(uint32_t id);
+    int         (*read)(fs_node_t* node, uint32_t offset, void* buf, uint32_t count);
+    int         (*write)(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count);
+    int         (*readdir)(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out);
+    int         (*copy_range)(const fs_node_t* src, uint32_t src_off, const fs_node_t* dst, uint32_t dst_off, uint32_t count);
+    int         (*clone)(uint32_t src_id, uint32_t parent_id, const char* name);
+    void        (*get_space)(uint32_t* total_kb, uint32_t* used_kb, uint32_t* free_kb);
+    int         (*sync)(uint32_t id, int datasync);
+} vfs_ops_t;
+
+/**
+ * @brief A mounted filesystem: root_id takes the place of covered_id
+ * in path lookups.
+ */
+typedef struct {
+    const vfs_ops_t* ops;
+    uint32_t root_id;
+    uint32_t covered_id;        // 0 for "/"
+    char     path[VFS_MAX_PATH];
+} vfs_mount_t;
+
+// --- Filesystem types ---
+extern const vfs_ops_t disk_fs_ops;     // src/fs.c
+extern const vfs_ops_t tmpfs_ops;       // src/tmpfs.c
+extern const vfs_ops_t procfs_ops;      // src/procfs.c
+extern const vfs_ops_t devfs_ops;       // src/devfs.c
+
+extern uint32_t vfs_root_id;
+
+/**
+ * @brief Mounts the disk on "/", an empty tmpfs on /tmp, procfs on
+ * /proc and devfs on /dev.
+ * Call after fs_init().
+ */
+void vfs_init();
+
+/**
+ * @brief Mounts a filesystem on an existing directory (or "/" first).
+ * @param root_id Root node; its tag must not belong to another type.
+ * @return 1 on success, 0 on failure.
+ */
+int vfs_mount(const char* path, const vfs_ops_t* ops, uint32_t root_id);
+
+/**
+ * @brief Returns mount table entry i, or 0 past the end.
+ */
+const vfs_mount_t* vfs_get_mount(uint32_t i);
+
+/**
+ * @brief Resolves a path across mount points ("/" and ".." included).
+ */
+fs_node_t* vfs_find_node(const char* path, uint32_t start_id);
+
+/**
+ * @brief Finds a child, stepping onto a filesystem mounted there.
+ * @return The child's ID, or 0 if not found.
+ */
+uint32_t vfs_lookup(uint32_t dir_id, const char* name, uint32_t len);
+
+/**
+ * @brief Returns the type flags (VFS_CACHED...) of the filesystem that
+ * owns a node, or 0 if no filesystem does.
+ */
+uint32_t vfs_flags(uint32_t id);
+
+/**
+ * @brief Returns the bytes per fs_node_t.blocks unit on the filesystem
+ * that owns a node (0 if it allocates nothing).
+ */
+uint32_t vfs_block_size(uint32_t id);
+
+// The calls below dispatch to the filesystem owning the node. Return
+// values are those of the matching fs_* function.
+fs_node_t* vfs_get_node(uint32_t id);
+int vfs_create(uint32_t parent_id, const char* name, uint8_t type);
+int vfs_delete(uint32_t id);                    // Fails on mount roots
+int vfs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out);
+int vfs_write(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count);
+
+/**
+ * @brief Reads file contents, through the page cache if the filesystem
+ * uses it.
+ */
+int vfs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count);
+
+/**
+ * @brief Reads file contents straight from the filesystem (for the page
+ * cache itself).
+ */
+int vfs_read_uncached(fs_node_t* node, uint32_t offset, void* buf, uint32_t count);
+
+/**
+ * @brief Copies between files. Within one filesystem its own copy_range
+ * is used; across filesystems the data goes through a kernel buffer.
+ * Like fs_copy_range(), leaves *src and *dst as they were.
+ */
+int vfs_copy_range(const fs_node_t* src, uint32_t src_off, const fs_node_t* dst, uint32_t dst_off, uint32_t count);
+
+/**
+ * @brief Makes a file's written data (and, unless datasync, its
+ * metadata) durable on filesystems that persist anything.
+ * @return 0 on success, -1 on a device error.
+ */
+int vfs_sync(uint32_t id, int datasync);
+
+/**
+ * @brief Clones within one filesystem that supports it.
+ * @return 1 on success, 0 on failure.
+ */
+int vfs_clone(uint32_t src_id, uint32_t parent_id, const char* name);
+
+#endif // VFS_H
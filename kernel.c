@@ -6,6 +6,7 @@
 #include "include/shell.h"
 #include "include/text.h"
 #include "include/fs.h"
+#include "include/vfs.h"
 #include "include/mouse.h"
 #include "include/string.h"
 #include "include/console.h"
@@ -38,6 +39,7 @@ void kernel_main() {
 
     // Initialize filesystem (will create /a and /h on first boot and set cwd to /a)
     fs_init();
+    vfs_init();  // Mounts the disk on / and tmpfs on /tmp
     for (volatile int i = 0; i < 100000000; i++);
 
     // Test memory
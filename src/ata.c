@@ -21,6 +21,12 @@
 // ATA Commands
 #define ATA_CMD_READ_PIO 0x20
 #define ATA_CMD_WRITE_PIO 0x30
+#define ATA_CMD_IDENTIFY 0xEC
+
+// Addressable sectors reported by IDENTIFY (0 = unknown)
+static uint32_t ata_total_sectors = 0;
+
+static ata_stats_t ata_stats;
 
 // --- CRITICAL FIX: Add 16-bit I/O functions ---
 static inline uint16_t inw(uint16_t port) {
@@ -107,12 +113,29 @@ void ata_init() {
         return;
     }
 
+    // Ask the drive for its size (IDENTIFY words 60-61: LBA28 sector count)
+    outb(ATA_PRIMARY_BASE_IO + ATA_REG_DRIVE_SEL, 0xA0);
+    outb(ATA_PRIMARY_BASE_IO + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    if (ata_wait_for_ready() == 0) {
+        uint16_t identify[ATA_SECTOR_SIZE / 2];
+        for (int i = 0; i < ATA_SECTOR_SIZE / 2; i++) {
+            identify[i] = inw(ATA_PRIMARY_BASE_IO + ATA_REG_DATA);
+        }
+        ata_total_sectors = identify[60] | ((uint32_t)identify[61] << 16);
+    }
+
     console_print_colored("ATA: Primary Master Drive initialized.\n", COLOR_GREEN_ON_BLACK);
 }
 
+uint32_t ata_get_sector_count() {
+    return ata_total_sectors;
+}
+
 
 int ata_read_sectors(uint32_t lba, uint8_t count, void* buffer) {
+    ata_stats.reads++;
     if (ata_setup_command(lba, count, ATA_CMD_READ_PIO) != 0) {
+        ata_stats.errors++;
         return -1;
     }
 
@@ -121,6 +144,7 @@ int ata_read_sectors(uint32_t lba, uint8_t count, void* buffer) {
         // Wait for the drive to be ready to transfer data (DRQ set)
         if (ata_wait_for_ready() != 0) {
             console_print_colored("ATA: Read sector failed - drive not ready.\n", COLOR_LIGHT_RED);
+            ata_stats.errors++;
             return -1;
         }
 
@@ -131,16 +155,22 @@ int ata_read_sectors(uint32_t lba, uint8_t count, void* buffer) {
         // -----------------------------------------------
 
         buf += ATA_SECTOR_SIZE / 2; // Move buffer pointer to next sector location
+        ata_stats.sectors_read++;
     }
 
     // Final check for BSY clear and DRQ clear
-    if (ata_wait_for_ready() != 0) return -1;
+    if (ata_wait_for_ready() != 0) {
+        ata_stats.errors++;
+        return -1;
+    }
 
     return 0;
 }
 
-int ata_write_sectors(uint32_t lba, uint8_t count, void* buffer) {
+int ata_write_sectors_noflush(uint32_t lba, uint8_t count, void* buffer) {
+    ata_stats.writes++;
     if (ata_setup_command(lba, count, ATA_CMD_WRITE_PIO) != 0) {
+        ata_stats.errors++;
         return -1;
     }
 
@@ -149,6 +179,7 @@ int ata_write_sectors(uint32_t lba, uint8_t count, void* buffer) {
         // Wait for the drive to be ready to accept data (DRQ set)
         if (ata_wait_for_ready() != 0) {
             console_print_colored("ATA: Write sector failed - drive not ready.\n", COLOR_LIGHT_RED);
+            ata_stats.errors++;
             return -1;
         }
 
@@ -159,16 +190,40 @@ int ata_write_sectors(uint32_t lba, uint8_t count, void* buffer) {
         // -----------------------------------------------
 
         buf += ATA_SECTOR_SIZE / 2; // Move buffer pointer to next sector location
+        ata_stats.sectors_written++;
+    }
+
+    // Wait for the drive to accept the last sector
+    if (ata_wait_for_ready() != 0) {
+        ata_stats.errors++;
+        return -1;
     }
 
+    return 0;
+}
+
+int ata_flush() {
+    ata_stats.flushes++;
     // Send the FLUSH CACHE command to ensure data is written to the physical platter
     outb(ATA_PRIMARY_BASE_IO + ATA_REG_COMMAND, 0xE7); // ATA_CMD_CACHE_FLUSH
 
     // Wait for the flush to complete
     if (ata_wait_for_ready() != 0) {
         console_print_colored("ATA: Write cache flush failed.\n", COLOR_LIGHT_RED);
+        ata_stats.errors++;
         return -1;
     }
 
     return 0;
 }
+
+int ata_write_sectors(uint32_t lba, uint8_t count, void* buffer) {
+    if (ata_write_sectors_noflush(lba, count, buffer) != 0) {
+        return -1;
+    }
+    return ata_flush();
+}
+
+void ata_get_stats(ata_stats_t* out) {
+    *out = ata_stats;
+}
@@ -0,0 +1,293 @@
+/**
+ * src/devfs.c - Device filesystem
+ * Exposes the console, the keyboard, the ATA disk and a RAM disk as
+ * nodes, so the ordinary open/read/write syscalls reach the drivers.
+ * Block devices take byte offsets: whole sectors go straight between
+ * the caller's buffer and the drive in multi-sector commands, and only
+ * a partial first or last sector passes through a bounce buffer.
+ */
+
+#include "../include/devfs.h"
+#include "../include/string.h"
+#include "../include/memory.h"
+#include "../include/console.h"
+#include "../include/interrupt.h"
+#include "../include/ata.h"
+
+#define RAMDISK_PAGES   (DEVFS_RAMDISK_KB / (PAGE_SIZE / 1024))
+
+typedef struct {
+    const char* name;
+    uint8_t type;
+    int (*read)(uint32_t offset, uint8_t* buf, uint32_t count);
+    int (*write)(uint32_t offset, const uint8_t* buf, uint32_t count);
+    uint32_t (*size)();
+} devfs_device_t;
+
+static int console_dev_read(uint32_t offset, uint8_t* buf, uint32_t count);
+static int console_dev_write(uint32_t offset, const uint8_t* buf, uint32_t count);
+static int keyboard_dev_read(uint32_t offset, uint8_t* buf, uint32_t count);
+static int disk_dev_read(uint32_t offset, uint8_t* buf, uint32_t count);
+static int disk_dev_write(uint32_t offset, const uint8_t* buf, uint32_t count);
+static uint32_t disk_dev_size();
+static int ram_dev_read(uint32_t offset, uint8_t* buf, uint32_t count);
+static int ram_dev_write(uint32_t offset, const uint8_t* buf, uint32_t count);
+static uint32_t ram_dev_size();
+
+// Index i + 1 is the low part of the device's ID (0 is the root)
+static const devfs_device_t devices[] = {
+    { "console",  FS_TYPE_CHAR_DEVICE,  console_dev_read,  console_dev_write, 0 },
+    { "keyboard", FS_TYPE_CHAR_DEVICE,  keyboard_dev_read, 0,                 0 },
+    { "hda",      FS_TYPE_BLOCK_DEVICE, disk_dev_read,     disk_dev_write,    disk_dev_size },
+    { "ram0",     FS_TYPE_BLOCK_DEVICE, ram_dev_read,      ram_dev_write,     ram_dev_size },
+};
+#define DEVFS_DEVICES (sizeof(devices) / sizeof(devices[0]))
+
+static fs_node_t nodes[DEVFS_DEVICES + 1];
+static int initialized = 0;
+static uint8_t bounce[ATA_SECTOR_SIZE];    // Partial sectors of /dev/hda
+static uint8_t* ramdisk = 0;
+
+// --- Character devices ---
+
+/**
+ * @brief Reads one line with echo, like the shell prompt does
+ */
+static int console_dev_read(uint32_t offset, uint8_t* buf, uint32_t count) {
+    (void)offset;  // A stream: no position
+    uint32_t done = 0;
+    while (done < count) {
+        char c = keyboard_read();
+        if (c == '\b') {
+            if (done > 0) {
+                done--;
+                console_putchar('\b', COLOR_WHITE_ON_BLACK);
+            }
+            continue;
+        }
+        console_putchar(c, COLOR_WHITE_ON_BLACK);
+        buf[done++] = c;
+        if (c == '\n') break;
+    }
+    return done;
+}
+
+static int console_dev_write(uint32_t offset, const uint8_t* buf, uint32_t count) {
+    (void)offset;
+    for (uint32_t i = 0; i < count; i++) {
+        console_putchar(buf[i], COLOR_WHITE_ON_BLACK);
+    }
+    return count;
+}
+
+/**
+ * @brief Raw keys: waits for the first, then takes whatever is buffered
+ */
+static int keyboard_dev_read(uint32_t offset, uint8_t* buf, uint32_t count) {
+    (void)offset;
+    if (count == 0) return 0;
+    uint32_t done = 0;
+    buf[done++] = keyboard_read();
+    while (done < count && keyboard_has_data()) {
+        buf[done++] = keyboard_read();
+    }
+    return done;
+}
+
+// --- Block devices ---
+
+static uint32_t disk_dev_size() {
+    uint32_t sectors = ata_get_sector_count();
+    if (sectors > 0xFFFFFFFF / ATA_SECTOR_SIZE) return 0xFFFFFFFF / ATA_SECTOR_SIZE * ATA_SECTOR_SIZE;
+    return sectors * ATA_SECTOR_SIZE;
+}
+
+static int disk_dev_read(uint32_t offset, uint8_t* buf, uint32_t count) {
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t lba = pos / ATA_SECTOR_SIZE;
+        uint32_t in_sector = pos % ATA_SECTOR_SIZE;
+
+        if (in_sector == 0 && count - done >= ATA_SECTOR_SIZE) {
+            // Whole sectors: read straight into the caller's buffer
+            uint32_t run = (count - done) / ATA_SECTOR_SIZE;
+            if (run > DEVFS_MAX_RUN) run = DEVFS_MAX_RUN;
+            if (ata_read_sectors(lba, run, buf + done) != 0) break;
+            done += run * ATA_SECTOR_SIZE;
+        } else {
+            uint32_t chunk = ATA_SECTOR_SIZE - in_sector;
+            if (chunk > count - done) chunk = count - done;
+            if (ata_read_sectors(lba, 1, bounce) != 0) break;
+            memcpy(buf + done, bounce + in_sector, chunk);
+            done += chunk;
+        }
+    }
+    return done > 0 ? (int)done : -1;
+}
+
+static int disk_dev_write(uint32_t offset, const uint8_t* buf, uint32_t count) {
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t lba = pos / ATA_SECTOR_SIZE;
+        uint32_t in_sector = pos % ATA_SECTOR_SIZE;
+
+        if (in_sector == 0 && count - done >= ATA_SECTOR_SIZE) {
+            uint32_t run = (count - done) / ATA_SECTOR_SIZE;
+            if (run > DEVFS_MAX_RUN) run = DEVFS_MAX_RUN;
+            if (ata_write_sectors_noflush(lba, run, (void*)(buf + done)) != 0) break;
+            done += run * ATA_SECTOR_SIZE;
+        } else {
+            // Partial sector: read-modify-write
+            uint32_t chunk = ATA_SECTOR_SIZE - in_sector;
+            if (chunk > count - done) chunk = count - done;
+            if (ata_read_sectors(lba, 1, bounce) != 0) break;
+            memcpy(bounce + in_sector, buf + done, chunk);
+            if (ata_write_sectors_noflush(lba, 1, bounce) != 0) break;
+            done += chunk;
+        }
+    }
+    if (done > 0 && ata_flush() != 0) return -1;  // One flush per call
+    return done > 0 ? (int)done : -1;
+}
+
+static uint32_t ram_dev_size() {
+    return DEVFS_RAMDISK_KB * 1024;
+}
+
+static int ram_dev_read(uint32_t offset, uint8_t* buf, uint32_t count) {
+    if (ramdisk) {
+        memcpy(buf, ramdisk + offset, count);
+    } else {
+        memset(buf, 0, count);  // Never written
+    }
+    return count;
+}
+
+static int ram_dev_write(uint32_t offset, const uint8_t* buf, uint32_t count) {
+    if (!ramdisk) {
+        ramdisk = (uint8_t*)pmm_alloc_pages(RAMDISK_PAGES);
+        if (!ramdisk) {
+            console_print_colored("devfs: Out of memory for the RAM disk.\n", COLOR_LIGHT_RED);
+            return -1;
+        }
+        memset(ramdisk, 0, RAMDISK_PAGES * PAGE_SIZE);
+    }
+    memcpy(ramdisk + offset, buf, count);
+    return count;
+}
+
+// --- Filesystem operations ---
+
+static const devfs_device_t* device_of(const fs_node_t* node) {
+    if (!initialized || !node || VFS_TAG(node->id) != DEVFS_TAG) return 0;
+    uint32_t index = node->id & ~DEVFS_ID_BASE;
+    return (index >= 1 && index <= DEVFS_DEVICES) ? &devices[index - 1] : 0;
+}
+
+/**
+ * @brief Clamps a block device transfer to the device's capacity
+ * @return The byte count that fits (0 past the end)
+ */
+static uint32_t clamp_to_device(const devfs_device_t* dev, uint32_t offset, uint32_t count) {
+    if (dev->type != FS_TYPE_BLOCK_DEVICE) return count;
+    uint32_t size = dev->size();
+    if (offset >= size) return 0;
+    return count > size - offset ? size - offset : count;
+}
+
+int devfs_init(const char* name) {
+    memset(nodes, 0, sizeof(nodes));
+    nodes[0].id = DEVFS_ROOT_ID;
+    nodes[0].parent_id = DEVFS_ROOT_ID;  // The VFS takes ".." out of the mount
+    nodes[0].type = FS_TYPE_DIRECTORY;
+    nodes[0].child_count = DEVFS_DEVICES;
+    strncpy(nodes[0].name, name, FS_MAX_NAME - 1);
+
+    for (uint32_t i = 0; i < DEVFS_DEVICES; i++) {
+        fs_node_t* node = &nodes[i + 1];
+        node->id = DEVFS_ID_BASE | (i + 1);
+        node->parent_id = DEVFS_ROOT_ID;
+        node->type = devices[i].type;
+        strcpy(node->name, devices[i].name);
+    }
+    initialized = 1;
+    return 1;
+}
+
+fs_node_t* devfs_get_node(uint32_t id) {
+    if (!initialized || VFS_TAG(id) != DEVFS_TAG) return 0;
+    uint32_t index = id & ~DEVFS_ID_BASE;
+    if (index > DEVFS_DEVICES) return 0;
+
+    fs_node_t* node = &nodes[index];
+    if (index > 0 && devices[index - 1].size) {
+        node->size = devices[index - 1].size();  // The disk is sized at boot
+    }
+    return node;
+}
+
+uint32_t devfs_lookup(uint32_t dir_id, const char* name, uint32_t len) {
+    if (dir_id != DEVFS_ROOT_ID || !initialized) return 0;
+    for (uint32_t i = 0; i < DEVFS_DEVICES; i++) {
+        if ((uint32_t)strlen(devices[i].name) == len && memcmp(devices[i].name, name, len) == 0) {
+            return nodes[i + 1].id;
+        }
+    }
+    return 0;
+}
+
+static int devfs_create(uint32_t parent_id, const char* name, uint8_t type) {
+    (void)parent_id; (void)name; (void)type;
+    return 0;  // The device set is fixed
+}
+
+static int devfs_remove(uint32_t id) {
+    (void)id;
+    return 0;
+}
+
+int devfs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count) {
+    const devfs_device_t* dev = device_of(node);
+    if (!dev || !dev->read) return -1;
+    count = clamp_to_device(dev, offset, count);
+    if (count == 0) return 0;
+    return dev->read(offset, (uint8_t*)buf, count);
+}
+
+int devfs_write(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count) {
+    const devfs_device_t* dev = device_of(node);
+    if (!dev || !dev->write) return -1;
+    if (count == 0) return 0;
+    count = clamp_to_device(dev, offset, count);
+    if (count == 0) return -1;  // Past the end of the device
+    return dev->write(offset, (const uint8_t*)buf, count);
+}
+
+int devfs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out) {
+    if (dir_id != DEVFS_ROOT_ID || !initialized || *cursor >= DEVFS_DEVICES) return 0;
+
+    fs_node_t* node = &nodes[++(*cursor)];
+    out->id = node->id;
+    out->type = node->type;
+    strcpy(out->name, node->name);
+    return 1;
+}
+
+const vfs_ops_t devfs_ops = {
+    .name       = "devfs",
+    .flags      = 0,
+    .block_size = 0,
+    .get_node   = devfs_get_node,
+    .lookup     = devfs_lookup,
+    .create     = devfs_create,
+    .remove     = devfs_remove,
+    .read       = devfs_read,
+    .write      = devfs_write,
+    .readdir    = devfs_readdir,
+    .copy_range = 0,
+    .clone      = 0,
+    .get_space  = 0,
+    .sync       = 0,
+};
@@ -1,6 +1,7 @@
 /**
  * src/fs.c - Lazy Loading Filesystem (Load-On-Demand)
- * Only loads nodes from disk when accessed, not at boot
+ * Only loads sectors from disk when accessed, not at boot.
+ * Inodes are packed four to a sector; file data lives in data blocks.
  */
 
 #include "../include/fs.h"
@@ -8,57 +9,451 @@
 #include "../include/memory.h"
 #include "../include/console.h"
 #include "../include/ata.h"
+#include "../include/pagecache.h"
+#include "../include/vfs.h"
 
 // --- Configuration ---
-#define FS_MAGIC         0xEF5342
-#define FS_MAX_NODES     128
-#define FS_ROOT_ID       1
-#define SECTOR_SIZE      512
+#define SECTOR_SIZE      FS_SECTOR_SIZE
+#define FS_DISK_SECTORS  (50 * 1024 * 2)   // Fallback when IDENTIFY fails
+#define FS_IO_CHUNK      128               // Max sectors per bitmap transfer
+#define FS_JOURNAL_GROUP_OPS 32            // Operations batched per commit
 
-// --- NEW: Cache Management ---
-#define FS_CACHE_SIZE    32  // Keep 32 nodes in RAM (adjustable)
+// --- v1 Format (only read while converting an old disk) ---
+#define FS_V1_MAX_NODES  128
+#define FS_V1_MAX_CHILDREN 16
+// v1 mkfs stored the root's 17th child past child_ids[] into padding
+#define FS_V1_CHILD_SLOTS (FS_V1_MAX_CHILDREN + 300 / 4)
 
 typedef struct {
-    fs_node_t node;          // The actual node data
-    uint32_t  id;            // Node ID (0 = empty slot)
-    uint32_t  last_access;   // For LRU eviction
-    uint8_t   dirty;         // 1 = modified, needs write-back
+    uint32_t id;
+    uint32_t parent_id;
+    uint8_t  type;
+    char     name[FS_MAX_NAME];
+    uint32_t size;
+    uint32_t child_count;
+    uint32_t child_ids[FS_V1_MAX_CHILDREN];
+    uint8_t  padding[300];
+} fs_node_v1_t;
+
+// --- Cache Management ---
+#define FS_CACHE_SIZE    64  // Keep 64 sectors in RAM (adjustable)
+
+typedef struct {
+    uint8_t   data[SECTOR_SIZE]; // Raw sector contents
+    uint32_t  lba;               // Sector number (0 = empty slot)
+    uint32_t  last_access;       // For LRU eviction
+    uint8_t   dirty;             // 1 = modified, needs write-back
 } fs_cache_entry_t;
 
-// --- Data Structures ---
+// --- Allocation Bitmaps ---
+// One bit per inode / per disk sector. The whole bitmap is kept in RAM;
+// changed bits are written back one sector at a time.
+typedef struct {
+    uint32_t* map;           // In-memory copy, padded to whole sectors
+    uint32_t  bits;          // Number of valid bits
+    uint32_t  start_lba;     // On-disk location
+    uint32_t  sectors;
+    uint32_t  capacity;      // Sectors' worth of memory behind map
+    uint32_t  hint;          // Next-fit: word to resume scanning from
+    uint32_t  free;          // Clear bits
+} fs_bitmap_t;
+
+// --- Metadata Journal ---
+// The running transaction group: a copy of every metadata sector changed
+// since the last commit, kept contiguous behind the descriptor so the
+// whole slot goes to disk in one write.
+typedef struct {
+    uint8_t*  buf;           // Descriptor, then the logged sectors
+    uint32_t  count;         // Sectors logged
+    uint32_t  sequence;      // Sequence number of the next commit
+    uint32_t  depth;         // Nesting of journal_begin()
+    uint32_t  ops;           // Operations finished in the running group
+    int       active;        // 0 = write metadata in place (format, convert)
+} fs_journal_t;
+
+// --- Path Lookup Cache (dcache) ---
+// Direct-mapped (parent ID, name) -> child ID. A child ID of 0 records a
+// name known to be absent, so failed probes are as cheap as hits.
+#define FS_DCACHE_SIZE   128
+
 typedef struct {
-    uint32_t magic;
-    uint32_t root_id;
-    uint32_t next_free_id;
-    uint32_t total_nodes;
-    uint32_t used_sectors;
-    uint8_t  reserved[492];
-} superblock_t;
+    uint32_t parent_id;          // 0 = empty slot
+    uint32_t child_id;           // 0 = negative entry
+    uint8_t  name_len;
+    char     name[FS_MAX_NAME - 1];
+} fs_dcache_entry_t;
+
+// Four inodes must fill a sector exactly
+typedef char fs_node_size_check[(sizeof(fs_node_t) == FS_INODE_SIZE) ? 1 : -1];
 
 // --- Globals ---
 uint32_t fs_root_id = FS_ROOT_ID;
 uint32_t fs_current_dir_id = FS_ROOT_ID;
 
 static superblock_t sb;
-static fs_cache_entry_t cache[FS_CACHE_SIZE];  // Cache instead of full table!
+static fs_cache_entry_t cache[FS_CACHE_SIZE];  // Sector cache (inodes + data)
 static uint32_t access_counter = 0;            // For LRU tracking
+static int converting = 0;                     // Defer superblock writes
+static fs_bitmap_t inode_map;                  // Which inode IDs are in use
+static fs_bitmap_t block_map;                  // Which sectors are in use
+static fs_dcache_entry_t dcache[FS_DCACHE_SIZE];
+static fs_journal_t journal;
+static int sb_dirty = 0;                       // Superblock awaits the next commit
+static int data_unflushed = 0;                 // File data may sit in the drive's cache
+static uint32_t dcache_hits = 0;
+static uint32_t dcache_misses = 0;
+static uint32_t fs_generation = 0;             // Bumped by every finished operation
+static uint8_t* copy_buf = 0;                  // FS_IO_CHUNK sectors for fs_copy_range()
+static fs_node_t refs_node;                    // Inode 0: shared block reference counts
 
 // Helper macros
-#define NODE_ID_TO_SECTOR(id) (FS_NODE_TABLE_START + (id) - 1)
+#define INODE_SECTOR(id) (sb.inode_table_start + (id) / FS_INODES_PER_SECTOR)
+#define V1_NODE_SECTOR(id) (FS_NODE_TABLE_START + (id) - 1)
+
+// --- Metadata Journal ---
+// While the journal is active, metadata sectors (inodes, directory and
+// pointer blocks, bitmaps, the superblock) are not written in place. They
+// collect in the running group, which is committed as a whole: descriptor
+// and sectors go to one of two slots in a single write, then one flush,
+// then the home locations are written without flushing. The next commit's
+// flush makes those home writes durable before their slot is reused, so
+// fs_init() only ever has to replay the newest valid slot.
+// File data goes straight to its blocks and rides on the commit's flush.
+
+static fs_journal_desc_t* journal_desc() {
+    return (fs_journal_desc_t*)journal.buf;
+}
+
+static uint8_t* journal_sector(uint32_t i) {
+    return journal.buf + (i + 1) * SECTOR_SIZE;
+}
+
+static uint32_t journal_slot_lba(uint32_t sequence) {
+    return FS_JOURNAL_START + (sequence & 1) * FS_JOURNAL_SLOT_SECTORS;
+}
+
+static uint32_t journal_checksum(fs_journal_desc_t* desc) {
+    uint32_t sum = 2166136261u ^ desc->sequence;
+    for (uint32_t i = 0; i < desc->count; i++) {
+        uint32_t* words = (uint32_t*)journal_sector(i);
+        sum = (sum ^ desc->lba[i]) * 16777619u;
+        for (uint32_t w = 0; w < SECTOR_SIZE / 4; w++) {
+            sum = (sum ^ words[w]) * 16777619u;
+        }
+    }
+    return sum;
+}
+
+/**
+ * @brief Returns the running group's copy of a sector, or 0
+ */
+static uint8_t* journal_find(uint32_t lba) {
+    if (!journal.buf) return 0;
+
+    fs_journal_desc_t* desc = journal_desc();
+    for (uint32_t i = 0; i < journal.count; i++) {
+        if (desc->lba[i] == lba) return journal_sector(i);
+    }
+    return 0;
+}
+
+static void journal_log(uint32_t lba, const void* data);
+
+/**
+ * @brief Writes the running group to its slot, flushes, then checkpoints
+ * it to the home locations
+ * @return 0 on success, -1 if the group may not be durable
+ */
+static int journal_commit() {
+    if (sb_dirty) {
+        sb_dirty = 0;
+        journal_log(FS_SUPERBLOCK_SECTOR, &sb);
+    }
+    if (journal.count == 0) return 0;
+
+    fs_journal_desc_t* desc = journal_desc();
+    desc->magic = FS_JOURNAL_MAGIC;
+    desc->sequence = journal.sequence;
+    desc->count = journal.count;
+    desc->checksum = journal_checksum(desc);
+
+    int err = ata_write_sectors_noflush(journal_slot_lba(journal.sequence), journal.count + 1, journal.buf);
+    if (ata_flush() != 0) err = -1;  // The group is durable from here on
+    data_unflushed = 0;               // And the file data written before it
+
+    for (uint32_t i = 0; i < journal.count; i++) {
+        ata_write_sectors_noflush(desc->lba[i], 1, journal_sector(i));
+    }
+
+    journal.sequence++;
+    journal.count = 0;
+    journal.ops = 0;
+    return err ? -1 : 0;
+}
+
+/**
+ * @brief Records a metadata sector in the running group
+ * A group only fills up mid-operation for operations larger than half the
+ * journal; those are committed in pieces.
+ */
+static void journal_log(uint32_t lba, const void* data) {
+    uint8_t* copy = journal_find(lba);
+    if (!copy) {
+        if (journal.count == FS_JOURNAL_MAX_BLOCKS) {
+            journal_commit();
+        }
+        journal_desc()->lba[journal.count] = lba;
+        copy = journal_sector(journal.count++);
+    }
+    memcpy(copy, data, SECTOR_SIZE);
+}
+
+/**
+ * @brief Drops a freed sector from the running group, so a replay can
+ * never write stale metadata over the block's next owner
+ */
+static void journal_forget(uint32_t lba) {
+    uint8_t* copy = journal_find(lba);
+    if (!copy) return;
+
+    uint32_t last = --journal.count;
+    fs_journal_desc_t* desc = journal_desc();
+    uint32_t i = (copy - journal.buf) / SECTOR_SIZE - 1;
+    if (i != last) {
+        desc->lba[i] = desc->lba[last];
+        memcpy(copy, journal_sector(last), SECTOR_SIZE);
+    }
+}
+
+static void journal_begin() {
+    journal.depth++;
+}
+
+/**
+ * @brief Ends an operation; commits once the group is big enough
+ */
+static void journal_end() {
+    if (--journal.depth > 0) return;
+
+    fs_generation++;
+    journal.ops++;
+    if (journal.count >= FS_JOURNAL_MAX_BLOCKS / 2 || journal.ops >= FS_JOURNAL_GROUP_OPS) {
+        journal_commit();
+    }
+}
+
+/**
+ * @brief Writes a metadata sector, through the journal when it is active
+ */
+static void write_meta(uint32_t lba, const void* data) {
+    if (journal.active) {
+        journal_log(lba, data);
+    } else {
+        ata_write_sectors(lba, 1, (void*)data);
+    }
+}
+
+/**
+ * @brief Allocates the group buffer (once)
+ * @return 1 on success, 0 if out of memory
+ */
+static int journal_setup() {
+    journal.active = 0;
+    journal.count = 0;
+    journal.depth = 0;
+    journal.ops = 0;
+    if (journal.buf) return 1;
+
+    uint32_t pages = (FS_JOURNAL_SLOT_SECTORS * SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+    journal.buf = (uint8_t*)pmm_alloc_pages(pages);
+    if (!journal.buf) {
+        console_print_colored("FS: Out of memory for the journal.\n", COLOR_LIGHT_RED);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Invalidates both slots (fresh or upgraded filesystems)
+ */
+static void journal_reset() {
+    if (!journal.buf) return;
+
+    memset(journal.buf, 0, SECTOR_SIZE);
+    ata_write_sectors_noflush(journal_slot_lba(0), 1, journal.buf);
+    ata_write_sectors(journal_slot_lba(1), 1, journal.buf);
+    journal.sequence = 1;
+}
+
+/**
+ * @brief Replays the newest valid slot after an unclean shutdown
+ * Replaying a slot that was already checkpointed is harmless.
+ */
+static void journal_replay() {
+    if (!journal.buf) return;
+
+    fs_journal_desc_t* desc = journal_desc();
+    uint32_t newest = 0;
+    int found = 0;
+
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        uint32_t lba = journal_slot_lba(slot);
+        if (ata_read_sectors(lba, 1, desc) != 0) continue;
+        if (desc->magic != FS_JOURNAL_MAGIC || desc->count == 0 ||
+            desc->count > FS_JOURNAL_MAX_BLOCKS || (desc->sequence & 1) != slot) {
+            continue;
+        }
+        if (ata_read_sectors(lba + 1, desc->count, journal_sector(0)) != 0) continue;
+        if (journal_checksum(desc) != desc->checksum) continue;  // Torn commit
+
+        if (!found || desc->sequence > newest) {
+            newest = desc->sequence;
+            found = 1;
+        }
+    }
+
+    journal.sequence = found ? newest + 1 : 1;
+    if (!found) return;
+
+    uint32_t lba = journal_slot_lba(newest);
+    ata_read_sectors(lba, 1, desc);
+    ata_read_sectors(lba + 1, desc->count, journal_sector(0));
+    for (uint32_t i = 0; i < desc->count; i++) {
+        ata_write_sectors_noflush(desc->lba[i], 1, journal_sector(i));
+    }
+    ata_flush();
+}
 
 // --- Internal Helpers ---
 
+/**
+ * @brief Persists the superblock
+ * With the journal active this only marks it: the counters live in RAM
+ * and the sector is logged once per commit, not once per operation.
+ */
 static void save_superblock() {
+    if (converting) return;
+    if (journal.active) {
+        sb_dirty = 1;
+        return;
+    }
     ata_write_sectors(FS_SUPERBLOCK_SECTOR, 1, &sb);
 }
 
+// --- Bitmap Helpers ---
+
+static int bitmap_test(fs_bitmap_t* bm, uint32_t index) {
+    if (index >= bm->bits) return 1;
+    return (bm->map[index / 32] >> (index % 32)) & 1;
+}
+
+static void bitmap_write_sector(fs_bitmap_t* bm, uint32_t index) {
+    uint32_t sector = index / FS_BITS_PER_SECTOR;
+    write_meta(bm->start_lba + sector, (uint8_t*)bm->map + sector * SECTOR_SIZE);
+}
+
+static void bitmap_set(fs_bitmap_t* bm, uint32_t index) {
+    bm->map[index / 32] |= 1u << (index % 32);
+    bm->free--;
+    bitmap_write_sector(bm, index);
+}
+
+static void bitmap_clear(fs_bitmap_t* bm, uint32_t index) {
+    if (!bitmap_test(bm, index)) return;
+    bm->map[index / 32] &= ~(1u << (index % 32));
+    bm->free++;
+    bitmap_write_sector(bm, index);
+}
+
+/**
+ * @brief Allocates a clear bit, preferring goal, then scanning next-fit
+ * a word at a time (full words are skipped with one compare).
+ * @return The bit index, or 0 if the bitmap is full (bit 0 is reserved)
+ */
+static uint32_t bitmap_alloc(fs_bitmap_t* bm, uint32_t goal) {
+    if (bm->free == 0) return 0;
+
+    if (goal != 0 && !bitmap_test(bm, goal)) {
+        bitmap_set(bm, goal);
+        return goal;
+    }
+
+    uint32_t words = (bm->bits + 31) / 32;
+    uint32_t w = bm->hint;
+    for (uint32_t n = 0; n < words; n++, w++) {
+        if (w >= words) w = 0;
+        if (bm->map[w] != 0xFFFFFFFF) {
+            uint32_t index = w * 32 + __builtin_ctz(~bm->map[w]);
+            bm->hint = w;
+            bitmap_set(bm, index);
+            return index;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Points a bitmap at its disk region and makes sure RAM backs it
+ * @return 1 on success, 0 if memory could not be allocated
+ */
+static int bitmap_setup(fs_bitmap_t* bm, uint32_t start_lba, uint32_t sectors, uint32_t bits) {
+    if (!bm->map || bm->capacity < sectors) {
+        uint32_t pages = (sectors * SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+        bm->map = (uint32_t*)pmm_alloc_pages(pages);
+        if (!bm->map) return 0;
+        bm->capacity = pages * (PAGE_SIZE / SECTOR_SIZE);
+    }
+    bm->start_lba = start_lba;
+    bm->sectors = sectors;
+    bm->bits = bits;
+    bm->hint = 0;
+    bm->free = 0;
+    return 1;
+}
+
+/**
+ * @brief Marks the padding past the last valid bit as used and counts
+ * the free bits.
+ */
+static void bitmap_finish(fs_bitmap_t* bm) {
+    uint32_t total_words = bm->sectors * (SECTOR_SIZE / 4);
+    for (uint32_t i = bm->bits; i < total_words * 32 && i % 32 != 0; i++) {
+        bm->map[i / 32] |= 1u << (i % 32);
+    }
+    for (uint32_t w = (bm->bits + 31) / 32; w < total_words; w++) {
+        bm->map[w] = 0xFFFFFFFF;
+    }
+
+    bm->free = 0;
+    for (uint32_t w = 0; w < total_words; w++) {
+        uint32_t clear = ~bm->map[w];
+        while (clear) {
+            clear &= clear - 1;
+            bm->free++;
+        }
+    }
+}
+
+static void bitmap_transfer(fs_bitmap_t* bm, int write) {
+    for (uint32_t done = 0; done < bm->sectors; done += FS_IO_CHUNK) {
+        uint32_t count = bm->sectors - done;
+        if (count > FS_IO_CHUNK) count = FS_IO_CHUNK;
+        uint8_t* buf = (uint8_t*)bm->map + done * SECTOR_SIZE;
+        if (write) {
+            ata_write_sectors(bm->start_lba + done, count, buf);
+        } else {
+            ata_read_sectors(bm->start_lba + done, count, buf);
+        }
+    }
+}
+
 /**
- * @brief Finds a node in the cache by ID
+ * @brief Finds a sector in the cache by LBA
  * @return Index in cache, or -1 if not found
  */
-static int cache_find(uint32_t id) {
+static int cache_find(uint32_t lba) {
     for (int i = 0; i < FS_CACHE_SIZE; i++) {
-        if (cache[i].id == id) {
+        if (cache[i].lba == lba) {
             cache[i].last_access = ++access_counter;  // Update LRU
             return i;
         }
@@ -73,7 +468,7 @@ static int cache_find(uint32_t id) {
 static int cache_find_slot() {
     // First, try to find an empty slot
     for (int i = 0; i < FS_CACHE_SIZE; i++) {
-        if (cache[i].id == 0) {
+        if (cache[i].lba == 0) {
             return i;
         }
     }
@@ -89,449 +484,1920 @@ static int cache_find_slot() {
         }
     }
 
-    // Write back if dirty
+    // Write back if dirty; through the running group, since the block
+    // may still belong to an older owner on disk until it commits
     if (cache[lru_index].dirty) {
-        ata_write_sectors(NODE_ID_TO_SECTOR(cache[lru_index].id),
-                         1, &cache[lru_index].node);
+        write_meta(cache[lru_index].lba, cache[lru_index].data);
     }
 
+    cache[lru_index].lba = 0;
+    cache[lru_index].dirty = 0;
     return lru_index;
 }
 
 /**
- * @brief Loads a node from disk into cache
- * @return Pointer to cached node, or NULL on error
+ * @brief Returns a cached sector, reading it from disk on a miss.
+ * The pointer is only valid until the next cache operation.
+ * @return Pointer to the sector data, or NULL on error
  */
-static fs_node_t* cache_load(uint32_t id) {
-    if (id == 0 || id >= FS_MAX_NODES) return 0;
+static uint8_t* cache_get(uint32_t lba) {
+    if (lba == 0) return 0;
 
-    // Check if already in cache
-    int idx = cache_find(id);
+    int idx = cache_find(lba);
     if (idx >= 0) {
-        return &cache[idx].node;  // Cache hit!
+        return cache[idx].data;  // Cache hit!
     }
 
-    // Not in cache - load from disk
     int slot = cache_find_slot();
-
-    // Read from disk
-    ata_read_sectors(NODE_ID_TO_SECTOR(id), 1, &cache[slot].node);
-
-    // Validate that we got the right node
-    if (cache[slot].node.id != id) {
-        return 0;  // Node doesn't exist or disk corruption
+    uint8_t* logged = journal_find(lba);  // Newer than the home copy
+    if (logged) {
+        memcpy(cache[slot].data, logged, SECTOR_SIZE);
+    } else if (ata_read_sectors(lba, 1, cache[slot].data) != 0) {
+        return 0;
     }
 
-    // Update cache metadata
-    cache[slot].id = id;
+    cache[slot].lba = lba;
     cache[slot].dirty = 0;
     cache[slot].last_access = ++access_counter;
+    return cache[slot].data;
+}
 
-    return &cache[slot].node;
+/**
+ * @brief Installs a zero-filled sector in the cache without reading it.
+ * Used for freshly allocated blocks; marked dirty so it reaches disk.
+ */
+static uint8_t* cache_get_zeroed(uint32_t lba) {
+    int idx = cache_find(lba);
+    if (idx < 0) {
+        idx = cache_find_slot();
+        cache[idx].lba = lba;
+        cache[idx].last_access = ++access_counter;
+    }
+    memset(cache[idx].data, 0, SECTOR_SIZE);
+    cache[idx].dirty = 1;
+    return cache[idx].data;
 }
 
 /**
- * @brief Marks a cached node as dirty (needs write-back)
+ * @brief Drops a sector from the cache without writing it back
  */
-static void cache_mark_dirty(uint32_t id) {
-    int idx = cache_find(id);
+static void cache_drop(uint32_t lba) {
+    int idx = cache_find(lba);
     if (idx >= 0) {
-        cache[idx].dirty = 1;
+        cache[idx].lba = 0;
+        cache[idx].dirty = 0;
     }
 }
 
 /**
- * @brief Writes a node to disk and updates cache
+ * @brief Writes a cached metadata sector through to disk (or the journal)
  */
-static void save_node(uint32_t id) {
-    if (id == 0 || id >= FS_MAX_NODES) return;
-
-    int idx = cache_find(id);
+static void cache_write(uint32_t lba) {
+    int idx = cache_find(lba);
     if (idx >= 0) {
-        // Node is in cache - write it
-        ata_write_sectors(NODE_ID_TO_SECTOR(id), 1, &cache[idx].node);
+        write_meta(lba, cache[idx].data);
         cache[idx].dirty = 0;
-    } else {
-        // Node not in cache - load it first, then write
-        fs_node_t* node = cache_load(id);
-        if (node) {
-            ata_write_sectors(NODE_ID_TO_SECTOR(id), 1, node);
-            cache_mark_dirty(id);
-            cache[cache_find(id)].dirty = 0;
-        }
     }
 }
 
 /**
- * @brief Flushes all dirty nodes to disk
+ * @brief Writes a cached file data sector in place
+ * With the journal active, the next commit's flush makes it durable.
  */
-void fs_sync() {
-    for (int i = 0; i < FS_CACHE_SIZE; i++) {
-        if (cache[i].id != 0 && cache[i].dirty) {
-            ata_write_sectors(NODE_ID_TO_SECTOR(cache[i].id),
-                            1, &cache[i].node);
-            cache[i].dirty = 0;
+static void cache_write_data(uint32_t lba) {
+    int idx = cache_find(lba);
+    if (idx >= 0) {
+        if (journal.active) {
+            ata_write_sectors_noflush(lba, 1, cache[idx].data);
+            data_unflushed = 1;
+        } else {
+            ata_write_sectors(lba, 1, cache[idx].data);
         }
+        cache[idx].dirty = 0;
     }
-    console_print_colored("FS: Cache synced to disk.\n", COLOR_GREEN_ON_BLACK);
 }
 
-// Formats the disk
-static void mkfs() {
-    console_print_colored("FS: Formatting drive...\n", COLOR_YELLOW_ON_BLACK);
+/**
+ * @brief Returns the inode table slot for an ID (valid or not)
+ */
+static fs_node_t* inode_slot(uint32_t id) {
+    if (id == 0 || id >= sb.max_nodes) return 0;
 
-    // Clear cache
-    memset(cache, 0, sizeof(cache));
+    uint8_t* sector = cache_get(INODE_SECTOR(id));
+    if (!sector) return 0;
+    return (fs_node_t*)sector + (id % FS_INODES_PER_SECTOR);
+}
 
-    // Setup Superblock
-    sb.magic = FS_MAGIC;
-    sb.root_id = FS_ROOT_ID;
-    sb.next_free_id = 2;
-    sb.total_nodes = 1;
-    sb.used_sectors = 1 + 60 + 1 + 1;  // boot + kernel + superblock + root
-
-    // Create Root Node
-    fs_node_t* root = cache_load(FS_ROOT_ID);
-    if (!root) {
-        int slot = cache_find_slot();
-        cache[slot].id = FS_ROOT_ID;
-        cache[slot].node.id = FS_ROOT_ID;
-        cache[slot].node.parent_id = FS_ROOT_ID;
-        cache[slot].node.type = FS_TYPE_DIRECTORY;
-        strcpy(cache[slot].node.name, "");
-        cache[slot].node.size = 0;
-        cache[slot].node.child_count = 0;
-        cache[slot].dirty = 1;
-        cache[slot].last_access = ++access_counter;
-        root = &cache[slot].node;
-    }
-
-    save_node(FS_ROOT_ID);
-
-    // Helper function to create directories
-     void CREATE_DIR(const char* name, const char* description)
-    {
-        uint32_t dir_id = sb.next_free_id++;
-        sb.total_nodes++;
-        sb.used_sectors++;
-        int slot = cache_find_slot();
-        cache[slot].id = dir_id;
-        cache[slot].node.id = dir_id;
-        cache[slot].node.parent_id = FS_ROOT_ID;
-        cache[slot].node.type = FS_TYPE_DIRECTORY;
-        strcpy(cache[slot].node.name, name);
-        cache[slot].node.size = 0;
-        cache[slot].node.child_count = 0;
-        cache[slot].dirty = 1;
-        cache[slot].last_access = ++access_counter;
-        root->child_ids[root->child_count++] = dir_id;
-        cache_mark_dirty(FS_ROOT_ID);
-        save_node(dir_id);
-        console_print_colored("FS: Created ", COLOR_GREEN_ON_BLACK);
-        console_print("/");
-        console_print(name);
-        console_print(" - ");
-        console_print(description);
-        console_print("\n");
-    }
-
-    // Create standard Unix directories
-    CREATE_DIR("bin", "Essential user commands");
-    CREATE_DIR("boot", "Boot files (informational)");
-    CREATE_DIR("dev", "Device files (future)");
-    CREATE_DIR("etc", "System configuration");
-    CREATE_DIR("home", "User home directories");
-    CREATE_DIR("lib", "Shared libraries (future)");
-    CREATE_DIR("mnt", "Mount points");
-    CREATE_DIR("opt", "Optional software");
-    CREATE_DIR("proc", "Process info (future)");
-    CREATE_DIR("root", "Root user home");
-    CREATE_DIR("sbin", "System binaries");
-    CREATE_DIR("sys", "System info (future)");
-    CREATE_DIR("tmp", "Temporary files");
-    CREATE_DIR("usr", "User programs");
-    CREATE_DIR("var", "Variable data");
-
-    // Create user workspace (your /a directory)
-    CREATE_DIR("a", "User workspace");
-
-    // Create history directory
-    CREATE_DIR("h", "Command history");
-
-    #undef CREATE_DIR
-
-    // Create system info files in /boot
-    uint32_t boot_id = fs_find_node_local_id(FS_ROOT_ID, "boot");
-    if (boot_id) {
-        // Create version file
-        if (fs_create_node(boot_id, "version", FS_TYPE_FILE)) {
-            uint32_t version_id = fs_find_node_local_id(boot_id, "version");
-            fs_node_t* version_file = fs_get_node(version_id);
-            if (version_file) {
-                char* content = (char*)version_file->padding;
-                strcpy(content, "PUNIX Kernel v1.03\n");
-                strcat(content, "Build: 2024-12-01\n");
-                strcat(content, "Architecture: x86 (32-bit)\n");
-                version_file->size = strlen(content);
-                fs_update_node(version_file);
-            }
-        }
+/**
+ * @brief Copies a node into its inode slot and writes the sector to disk
+ */
+static void save_node(uint32_t id, const fs_node_t* node) {
+    fs_node_t* slot = inode_slot(id);
+    if (!slot) return;
+    if (slot != node) {
+        memcpy(slot, node, sizeof(fs_node_t));
+    }
+    cache_write(INODE_SECTOR(id));
+}
 
-        // Create README
-        if (fs_create_node(boot_id, "README", FS_TYPE_FILE)) {
-            uint32_t readme_id = fs_find_node_local_id(boot_id, "README");
-            fs_node_t* readme_file = fs_get_node(readme_id);
-            if (readme_file) {
-                char* content = (char*)readme_file->padding;
-                strcpy(content, "Boot Directory\n");
-                strcat(content, "==============\n\n");
-                strcat(content, "This directory contains system information.\n");
-                strcat(content, "The actual bootloader and kernel are stored\n");
-                strcat(content, "in fixed disk sectors (0-60), not in the\n");
-                strcat(content, "filesystem.\n\n");
-                strcat(content, "Bootloader: Sector 0 (512 bytes)\n");
-                strcat(content, "Kernel:     Sectors 1-60 (~30 KB)\n");
-                readme_file->size = strlen(content);
-                fs_update_node(readme_file);
-            }
-        }
+/**
+ * @brief Allocates a zeroed data block and charges it to a node
+ * @param goal Preferred sector (keeps a file contiguous), or 0
+ * @return LBA of the block, or 0 if the disk is full
+ */
+static uint32_t alloc_block(fs_node_t* node, uint32_t goal) {
+    uint32_t lba = bitmap_alloc(&block_map, goal);
+    if (lba == 0) return 0;
+
+    sb.next_free_lba = block_map.hint * 32;
+    sb.used_sectors++;
+    node->blocks++;
+    cache_get_zeroed(lba);
+    return lba;
+}
+
+static uint32_t block_refs(uint32_t lba);
+static int block_ref_adjust(uint32_t lba, int delta);
+
+/**
+ * @brief Returns a block to the free pool
+ * A shared block only loses one reference; the other owners keep it.
+ */
+static void free_block(uint32_t lba) {
+    if (lba < sb.data_start || lba >= sb.total_sectors) return;
+    if (!bitmap_test(&block_map, lba)) return;
+    if (block_refs(lba)) {
+        block_ref_adjust(lba, -1);
+        return;
     }
 
-    // Create /etc/motd (Message of the Day)
-    uint32_t etc_id = fs_find_node_local_id(FS_ROOT_ID, "etc");
-    if (etc_id) {
-        if (fs_create_node(etc_id, "motd", FS_TYPE_FILE)) {
-            uint32_t motd_id = fs_find_node_local_id(etc_id, "motd");
-            fs_node_t* motd_file = fs_get_node(motd_id);
-            if (motd_file) {
-                char* content = (char*)motd_file->padding;
-                strcpy(content, "Welcome to PUNIX!\n");
-                strcat(content, "Type 'help' for available commands.\n");
-                motd_file->size = strlen(content);
-                fs_update_node(motd_file);
+    bitmap_clear(&block_map, lba);
+    sb.used_sectors--;
+    cache_drop(lba);
+    journal_forget(lba);
+}
+
+/**
+ * @brief Frees a pointer block and everything it points to
+ * @param depth 1 = points at data blocks, 2 = points at pointer blocks
+ */
+static void free_table(uint32_t table_lba, int depth) {
+    uint32_t ptrs[FS_PTRS_PER_BLOCK];
+    uint8_t* table = cache_get(table_lba);
+    if (table) {
+        memcpy(ptrs, table, SECTOR_SIZE);
+        for (uint32_t i = 0; i < FS_PTRS_PER_BLOCK; i++) {
+            if (ptrs[i] == 0) continue;
+            if (depth > 1) {
+                free_table(ptrs[i], depth - 1);
+            } else {
+                free_block(ptrs[i]);
             }
         }
     }
+    free_block(table_lba);
+}
 
-    save_node(FS_ROOT_ID);
-    save_superblock();
+/**
+ * @brief Releases every data block owned by a node
+ */
+static void free_node_blocks(fs_node_t* node) {
+    for (uint32_t i = 0; i < FS_DIRECT_BLOCKS; i++) {
+        free_block(node->direct[i]);
+        node->direct[i] = 0;
+    }
+    if (node->indirect) free_table(node->indirect, 1);
+    if (node->double_indirect) free_table(node->double_indirect, 2);
+    node->indirect = 0;
+    node->double_indirect = 0;
+    node->blocks = 0;
+    node->size = 0;
+}
 
-    console_print_colored("\nFS: Format complete. ", COLOR_GREEN_ON_BLACK);
-    console_print_colored("Standard directory structure created.\n", COLOR_GREEN_ON_BLACK);
+/**
+ * @brief Looks up (and optionally fills) one slot of a pointer block
+ */
+static uint32_t map_slot(fs_node_t* node, uint32_t table_lba, uint32_t index, int alloc) {
+    uint32_t* table = (uint32_t*)cache_get(table_lba);
+    if (!table) return 0;
+
+    uint32_t lba = table[index];
+    if (lba == 0 && alloc) {
+        uint32_t goal = index > 0 && table[index - 1] ? table[index - 1] + 1 : table_lba + 1;
+        lba = alloc_block(node, goal);
+        if (lba == 0) return 0;
+
+        // Allocation may have recycled the table's cache slot
+        table = (uint32_t*)cache_get(table_lba);
+        if (!table) return 0;
+        table[index] = lba;
+        cache_write(table_lba);
+    }
+    return lba;
 }
 
-// --- Public API ---
+/**
+ * @brief Maps a file block index to its sector on disk
+ * @param alloc 1 = allocate missing blocks (and pointer blocks) on the way
+ * @return LBA of the block, or 0 if it is a hole / cannot be allocated
+ */
+static uint32_t bmap(fs_node_t* node, uint32_t block, int alloc) {
+    if (block < FS_DIRECT_BLOCKS) {
+        if (node->direct[block] == 0 && alloc) {
+            uint32_t goal = block > 0 && node->direct[block - 1] ? node->direct[block - 1] + 1 : 0;
+            node->direct[block] = alloc_block(node, goal);
+        }
+        return node->direct[block];
+    }
+    block -= FS_DIRECT_BLOCKS;
 
-void fs_init() {
-    // Initialize cache
-    memset(cache, 0, sizeof(cache));
-    access_counter = 0;
+    if (block < FS_PTRS_PER_BLOCK) {
+        if (node->indirect == 0) {
+            if (!alloc) return 0;
+            node->indirect = alloc_block(node, node->direct[FS_DIRECT_BLOCKS - 1] + 1);
+            if (node->indirect == 0) return 0;
+        }
+        return map_slot(node, node->indirect, block, alloc);
+    }
+    block -= FS_PTRS_PER_BLOCK;
 
-    // Read Superblock ONLY (not all nodes!)
-    ata_read_sectors(FS_SUPERBLOCK_SECTOR, 1, &sb);
+    if (block < FS_PTRS_PER_BLOCK * FS_PTRS_PER_BLOCK) {
+        if (node->double_indirect == 0) {
+            if (!alloc) return 0;
+            node->double_indirect = alloc_block(node, 0);
+            if (node->double_indirect == 0) return 0;
+        }
+        uint32_t table = map_slot(node, node->double_indirect, block / FS_PTRS_PER_BLOCK, alloc);
+        if (table == 0) return 0;
+        return map_slot(node, table, block % FS_PTRS_PER_BLOCK, alloc);
+    }
 
-    if (sb.magic != FS_MAGIC) {
-        console_print_colored("FS: No filesystem detected.\n", COLOR_LIGHT_RED);
-        mkfs();
+    return 0;  // Beyond the maximum file size
+}
+
+/**
+ * @brief Points a file block at a given sector, allocating any missing
+ * pointer blocks. The caller accounts for the sector itself.
+ * @return 1 on success, 0 if a pointer block could not be allocated
+ */
+static int bmap_set(fs_node_t* node, uint32_t block, uint32_t lba) {
+    if (block < FS_DIRECT_BLOCKS) {
+        node->direct[block] = lba;
+        return 1;
+    }
+    block -= FS_DIRECT_BLOCKS;
+
+    uint32_t table;
+    if (block < FS_PTRS_PER_BLOCK) {
+        if (node->indirect == 0) {
+            node->indirect = alloc_block(node, node->direct[FS_DIRECT_BLOCKS - 1] + 1);
+        }
+        table = node->indirect;
     } else {
-        console_print_colored("FS: Filesystem mounted (lazy loading enabled).\n", COLOR_GREEN_ON_BLACK);
-        // NOTE: We DON'T load all nodes here anymore!
-        // They will be loaded on-demand when accessed
+        block -= FS_PTRS_PER_BLOCK;
+        if (block >= FS_PTRS_PER_BLOCK * FS_PTRS_PER_BLOCK) return 0;
+        if (node->double_indirect == 0) {
+            node->double_indirect = alloc_block(node, 0);
+            if (node->double_indirect == 0) return 0;
+        }
+        table = map_slot(node, node->double_indirect, block / FS_PTRS_PER_BLOCK, 1);
+        block %= FS_PTRS_PER_BLOCK;
     }
 
-    fs_root_id = FS_ROOT_ID;
+    uint32_t* ptrs = table ? (uint32_t*)cache_get(table) : 0;
+    if (!ptrs) return 0;
+    ptrs[block] = lba;
+    cache_write(table);
+    return 1;
+}
 
-    // Load root and /a into cache for initial access
-    cache_load(FS_ROOT_ID);
+// --- Shared Blocks ---
+// Clones share data blocks instead of copying them. Each block's extra
+// references (one byte per sector) are the data of inode 0, which is
+// never a file: byte n of that data counts the extra owners of LBA n.
+// Only the count sectors that were ever needed exist, and a filesystem
+// that never cloned has none, so the common path costs one compare.
+// Pointer blocks are never shared; a clone gets its own.
 
-    fs_node_t* dir_a = fs_find_node("a", fs_root_id);
-    if (dir_a && dir_a->type == FS_TYPE_DIRECTORY) {
-        fs_current_dir_id = dir_a->id;
-        console_print_colored("FS: Working directory set to /a.\n", COLOR_GREEN_ON_BLACK);
+#define FS_MAX_REFS 255
+
+static void refs_load() {
+    fs_node_t* table = (fs_node_t*)cache_get(INODE_SECTOR(FS_REFS_ID));
+    if (table) {
+        refs_node = table[FS_REFS_ID];
     } else {
-        fs_current_dir_id = fs_root_id;
+        memset(&refs_node, 0, sizeof(refs_node));
     }
 }
 
-// Get node - now uses cache with lazy loading!
-fs_node_t* fs_get_node(uint32_t id) {
-    return cache_load(id);  // Loads from disk if not in cache
+static void refs_save() {
+    fs_node_t* table = (fs_node_t*)cache_get(INODE_SECTOR(FS_REFS_ID));
+    if (!table) return;
+    table[FS_REFS_ID] = refs_node;
+    cache_write(INODE_SECTOR(FS_REFS_ID));
 }
 
-int fs_update_node(fs_node_t* node) {
-    if (!node || node->id == 0) return 0;
-    cache_mark_dirty(node->id);
-    save_node(node->id);
-    return 1;
+/**
+ * @brief Extra owners of a block (0 = owned by one file only)
+ */
+static uint32_t block_refs(uint32_t lba) {
+    if (refs_node.blocks == 0) return 0;
+
+    uint32_t counts_lba = bmap(&refs_node, lba / SECTOR_SIZE, 0);
+    if (counts_lba == 0) return 0;
+    uint8_t* counts = cache_get(counts_lba);
+    return counts ? counts[lba % SECTOR_SIZE] : 0;
 }
 
-uint32_t fs_find_node_local_id(uint32_t parent_id, char* name) {
-    fs_node_t* parent = fs_get_node(parent_id);  // Lazy loads parent
-    if (!parent || parent->type != FS_TYPE_DIRECTORY) return 0;
+/**
+ * @brief Adds (delta = 1) or drops (delta = -1) an extra reference
+ * @return 1 on success, 0 if the count is saturated or out of space
+ */
+static int block_ref_adjust(uint32_t lba, int delta) {
+    uint32_t old_blocks = refs_node.blocks;
+    uint32_t counts_lba = bmap(&refs_node, lba / SECTOR_SIZE, delta > 0);
+    if (refs_node.blocks != old_blocks) {
+        refs_save();  // A count sector (and maybe a pointer block) was added
+    }
+    if (counts_lba == 0) return 0;
+
+    uint8_t* counts = cache_get(counts_lba);
+    if (!counts) return 0;
+    uint8_t* count = &counts[lba % SECTOR_SIZE];
+    if (delta > 0 && *count == FS_MAX_REFS) return 0;
+    if (delta < 0 && *count == 0) return 0;
+    *count += delta;
+    cache_write(counts_lba);
+    return 1;
+}
 
-    for (uint32_t i = 0; i < parent->child_count; i++) {
-        uint32_t child_id = parent->child_ids[i];
-        fs_node_t* child = fs_get_node(child_id);  // Lazy loads child
-        if (child && strcmp(child->name, name) == 0) {
-            return child_id;
-        }
+/**
+ * @brief Gives a node its own copy of a shared block (copy on write)
+ * @param overwrite 1 = the caller replaces the whole sector, skip the copy
+ * @return The private block's LBA, or 0 if the disk is full
+ */
+static uint32_t unshare_block(fs_node_t* node, uint32_t block, uint32_t lba, int overwrite) {
+    static uint8_t data[SECTOR_SIZE];
+
+    uint32_t copy = alloc_block(node, lba + 1);
+    if (copy == 0) return 0;
+    if (!overwrite) {
+        uint8_t* old = cache_get(lba);
+        if (old) memcpy(data, old, SECTOR_SIZE);
+        uint8_t* fresh = cache_get(copy);
+        if (old && fresh) memcpy(fresh, data, SECTOR_SIZE);
     }
-    return 0;
+
+    if (!bmap_set(node, block, copy)) return 0;
+    block_ref_adjust(lba, -1);
+    node->blocks--;  // Traded the shared block for the copy
+    return copy;
 }
 
-fs_node_t* fs_find_node(char* path, uint32_t start_id) {
-    if (!path) return 0;
+/**
+ * @brief Writes data into a node's blocks without persisting the node
+ * Updates node->size and the block pointers; caller saves the node.
+ * @return Bytes written
+ */
+static uint32_t write_data(fs_node_t* node, uint32_t offset, const void* buf, uint32_t count) {
+    const uint8_t* in = (const uint8_t*)buf;
+    uint32_t done = 0;
+
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t in_block = pos % SECTOR_SIZE;
+        uint32_t chunk = SECTOR_SIZE - in_block;
+        if (chunk > count - done) chunk = count - done;
+
+        uint32_t lba = bmap(node, pos / SECTOR_SIZE, 1);
+        if (lba != 0 && block_refs(lba)) {
+            lba = unshare_block(node, pos / SECTOR_SIZE, lba, chunk == SECTOR_SIZE);
+        }
+        if (lba == 0) {
+            console_print_colored("FS: Disk full.\n", COLOR_LIGHT_RED);
+            break;
+        }
 
-    uint32_t current_id = start_id;
+        uint8_t* data = cache_get(lba);
+        if (!data) break;
+        memcpy(data + in_block, in + done, chunk);
+        cache_write_data(lba);
 
-    if (path[0] == '/') {
-        current_id = fs_root_id;
-        path++;
+        done += chunk;
     }
 
-    char temp_path[128];
-    strncpy(temp_path, path, 127);
-    temp_path[127] = '\0';
-    char* component = temp_path;
-    char* next_component = 0;
+    if (offset + done > node->size) {
+        node->size = offset + done;
+    }
+    return done;
+}
 
-    while (*component != '\0') {
-        int i = 0;
-        while (component[i] != '/' && component[i] != '\0') {
-            i++;
-        }
+// --- Directory Entries ---
+// A directory's data blocks hold fs_disk_dirent_t records, so lookups and
+// listings never have to load the child inodes.
 
-        if (component[i] == '/') {
-            component[i] = '\0';
-            next_component = component + i + 1;
+/**
+ * @brief Checks a record before anything trusts its fields
+ * It must be aligned, stay within the sector and hold its whole name, so
+ * neither a corrupt block nor a stray offset can overrun a name buffer.
+ */
+static int dirent_valid(uint8_t* block, uint32_t off) {
+    if ((off & 3) != 0 || off + FS_DIRENT_HEADER > SECTOR_SIZE) return 0;
+
+    fs_disk_dirent_t* de = (fs_disk_dirent_t*)(block + off);
+    return de->rec_len >= FS_DIRENT_HEADER && (de->rec_len & 3) == 0 &&
+           off + de->rec_len <= SECTOR_SIZE && de->name_len < FS_MAX_NAME &&
+           FS_DIRENT_HEADER + de->name_len <= de->rec_len;
+}
+
+/**
+ * @brief Finds a name (or, with name == 0, an ID) within one block
+ * @return Offset of the record, or -1 if absent
+ */
+static int block_find(uint8_t* block, const char* name, uint32_t len, uint32_t id) {
+    uint32_t off = 0;
+    while (off < SECTOR_SIZE && dirent_valid(block, off)) {
+        fs_disk_dirent_t* de = (fs_disk_dirent_t*)(block + off);
+        if (de->id != 0) {
+            if (name ? (de->name_len == len && memcmp(de->name, name, len) == 0)
+                     : de->id == id) {
+                return off;
+            }
+        }
+        off += de->rec_len;
+    }
+    return -1;
+}
+
+/**
+ * @brief Inserts a record into the first gap large enough for it
+ * @return 1 on success, 0 if the block has no room
+ */
+static int block_insert(uint8_t* block, uint32_t id, uint8_t type, const char* name, uint32_t len) {
+    uint32_t need = FS_DIRENT_SIZE(len);
+    uint32_t off = 0;
+
+    while (off < SECTOR_SIZE && dirent_valid(block, off)) {
+        fs_disk_dirent_t* de = (fs_disk_dirent_t*)(block + off);
+        uint32_t used = de->id ? FS_DIRENT_SIZE(de->name_len) : 0;
+
+        if (de->rec_len - used >= need) {
+            if (used) {
+                // Split: the live record keeps its bytes, the slack follows
+                uint16_t slack = de->rec_len - used;
+                de->rec_len = used;
+                de = (fs_disk_dirent_t*)(block + off + used);
+                de->rec_len = slack;
+            }
+            de->id = id;
+            de->type = type;
+            de->name_len = len;
+            memcpy(de->name, name, len);
+            return 1;
+        }
+        off += de->rec_len;
+    }
+    return 0;
+}
+
+/**
+ * @brief Removes the record at off, folding its space into the previous one
+ */
+static void block_remove(uint8_t* block, uint32_t off) {
+    uint32_t prev = 0;
+    uint32_t cur = 0;
+
+    while (cur < off && dirent_valid(block, cur)) {
+        prev = cur;
+        cur += ((fs_disk_dirent_t*)(block + cur))->rec_len;
+    }
+
+    fs_disk_dirent_t* de = (fs_disk_dirent_t*)(block + off);
+    if (off == 0) {
+        de->id = 0;
+    } else {
+        ((fs_disk_dirent_t*)(block + prev))->rec_len += de->rec_len;
+    }
+}
+
+static void block_init(uint8_t* block) {
+    memset(block, 0, SECTOR_SIZE);
+    ((fs_disk_dirent_t*)block)->rec_len = SECTOR_SIZE;
+}
+
+/**
+ * @brief Appends a zeroed block to a directory
+ * Updates dir (size, blocks); the caller saves the node.
+ * @return The new block's LBA, or 0 if none could be allocated
+ */
+static uint32_t dir_append_block(fs_node_t* dir, uint32_t* block_no) {
+    uint32_t b = dir->size / SECTOR_SIZE;
+    uint32_t lba = bmap(dir, b, 1);
+    if (!lba) return 0;
+    dir->size += SECTOR_SIZE;
+    *block_no = b;
+    return lba;
+}
+
+// --- Hashed Directory Index ---
+// Once a directory outgrows its first block, block 0 becomes the root of
+// a hash index: (hash, block) pairs sorted by name hash, optionally
+// through interior index blocks, leading to one leaf block of ordinary
+// entries. Every entry with a given hash lives in the same leaf, so a
+// lookup reads at most FS_DX_MAX_LEVELS index blocks and one leaf.
+// Index blocks open with an unused record spanning the whole sector, so
+// fs_readdir() walks past them like any empty block.
+
+#define DX_MAX_LEAF_ENTRIES (SECTOR_SIZE / FS_DIRENT_SIZE(1))
+
+typedef struct {
+    uint32_t block;     // Directory-relative index block
+    uint32_t pos;       // Entry followed within it
+} dx_frame_t;
+
+static fs_dx_header_t* dx_header(uint8_t* block) {
+    return (fs_dx_header_t*)(block + FS_DIRENT_HEADER);
+}
+
+static fs_dx_entry_t* dx_entries(uint8_t* block) {
+    return (fs_dx_entry_t*)(block + FS_DIRENT_HEADER + sizeof(fs_dx_header_t));
+}
+
+static void dx_init_block(uint8_t* block, uint8_t levels) {
+    block_init(block);
+    dx_header(block)->limit = FS_DX_LIMIT;
+    dx_header(block)->levels = levels;
+}
+
+/**
+ * @brief Binary search for the last index entry whose hash is <= hash
+ * entries[0] always covers hash 0, so there is always a match.
+ */
+static uint32_t dx_search(uint8_t* block, uint32_t hash) {
+    fs_dx_entry_t* e = dx_entries(block);
+    uint32_t lo = 0;
+    uint32_t hi = dx_header(block)->count;
+
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (e[mid].hash <= hash) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void dx_insert_entry(uint8_t* block, uint32_t pos, uint32_t hash, uint32_t child) {
+    fs_dx_header_t* hdr = dx_header(block);
+    fs_dx_entry_t* e = dx_entries(block);
+
+    for (uint32_t i = hdr->count; i > pos; i--) {
+        e[i] = e[i - 1];
+    }
+    e[pos].hash = hash;
+    e[pos].block = child;
+    hdr->count++;
+}
+
+/**
+ * @brief Walks the index from the root to the leaf covering hash
+ * @return Number of index levels walked (frames filled), 0 if corrupt
+ */
+static uint32_t dx_descend(fs_node_t* dir, uint32_t hash, dx_frame_t* frames, uint32_t* leaf) {
+    uint8_t* block = cache_get(bmap(dir, 0, 0));
+    if (!block) return 0;
+
+    uint32_t levels = dx_header(block)->levels;
+    if (levels == 0 || levels > FS_DX_MAX_LEVELS) return 0;
+
+    uint32_t block_no = 0;
+    for (uint32_t level = 0; level < levels; level++) {
+        block = cache_get(bmap(dir, block_no, 0));
+        if (!block || dx_header(block)->count == 0) return 0;
+
+        uint32_t pos = dx_search(block, hash);
+        frames[level].block = block_no;
+        frames[level].pos = pos;
+        block_no = dx_entries(block)[pos].block;
+    }
+
+    *leaf = block_no;
+    return levels;
+}
+
+/**
+ * @brief Makes room for one more entry in the index block at frames[level]
+ * Full blocks are split in half; a full root moves its entries into a
+ * new child and gains a level.
+ * @return 1 if there was room, 2 if the index changed shape (the caller
+ * must descend again), 0 on failure
+ */
+static int dx_make_room(fs_node_t* dir, dx_frame_t* frames, uint32_t level) {
+    uint8_t* block = cache_get(bmap(dir, frames[level].block, 0));
+    if (!block) return 0;
+    if (dx_header(block)->count < dx_header(block)->limit) return 1;
+
+    if (level == 0) {
+        uint8_t levels = dx_header(block)->levels;
+        if (levels >= FS_DX_MAX_LEVELS) {
+            console_print_colored("FS: Directory full.\n", COLOR_LIGHT_RED);
+            return 0;
+        }
+
+        uint32_t child_no;
+        uint32_t child_lba = dir_append_block(dir, &child_no);
+        if (!child_lba) return 0;
+
+        uint32_t root_lba = bmap(dir, 0, 0);
+        block = cache_get(root_lba);
+        uint8_t* child = cache_get(child_lba);
+        if (!block || !child) return 0;
+
+        memcpy(child, block, SECTOR_SIZE);
+        dx_header(child)->levels = 0;
+        cache_write(child_lba);
+
+        dx_init_block(block, levels + 1);
+        dx_insert_entry(block, 0, 0, child_no);
+        cache_write(root_lba);
+        return 2;
+    }
+
+    int parent = dx_make_room(dir, frames, level - 1);
+    if (parent != 1) return parent;
+
+    // Move the upper half into a new sibling and link it from the parent
+    uint32_t sibling_no;
+    uint32_t sibling_lba = dir_append_block(dir, &sibling_no);
+    if (!sibling_lba) return 0;
+
+    uint32_t lba = bmap(dir, frames[level].block, 0);
+    block = cache_get(lba);
+    uint8_t* sibling = cache_get(sibling_lba);
+    if (!block || !sibling) return 0;
+
+    uint32_t count = dx_header(block)->count;
+    uint32_t half = count / 2;
+    dx_init_block(sibling, 0);
+    memcpy(dx_entries(sibling), dx_entries(block) + half, (count - half) * sizeof(fs_dx_entry_t));
+    dx_header(sibling)->count = count - half;
+    dx_header(block)->count = half;
+    uint32_t split_hash = dx_entries(sibling)[0].hash;
+    cache_write(sibling_lba);
+    cache_write(lba);
+
+    uint32_t parent_lba = bmap(dir, frames[level - 1].block, 0);
+    block = cache_get(parent_lba);
+    if (!block) return 0;
+    dx_insert_entry(block, frames[level - 1].pos + 1, split_hash, sibling_no);
+    cache_write(parent_lba);
+    return 2;
+}
+
+/**
+ * @brief Splits a full leaf by hash, moving the upper half to a new block
+ * Entries sharing a hash always stay together.
+ * @return 1 on success, 0 on failure
+ */
+static int dx_split_leaf(fs_node_t* dir, uint32_t leaf, uint32_t* split_hash, uint32_t* new_leaf) {
+    static uint8_t copy[SECTOR_SIZE];
+    uint32_t offs[DX_MAX_LEAF_ENTRIES];
+    uint32_t hashes[DX_MAX_LEAF_ENTRIES];
+
+    uint32_t lba = bmap(dir, leaf, 0);
+    uint8_t* block = cache_get(lba);
+    if (!block) return 0;
+    memcpy(copy, block, SECTOR_SIZE);
+
+    // Collect the live records, sorted by hash
+    uint32_t count = 0;
+    uint32_t off = 0;
+    while (off < SECTOR_SIZE && dirent_valid(copy, off) && count < DX_MAX_LEAF_ENTRIES) {
+        fs_disk_dirent_t* de = (fs_disk_dirent_t*)(copy + off);
+        if (de->id != 0) {
+            uint32_t hash = fs_name_hash(de->name, de->name_len);
+            uint32_t i = count++;
+            while (i > 0 && hashes[i - 1] > hash) {
+                hashes[i] = hashes[i - 1];
+                offs[i] = offs[i - 1];
+                i--;
+            }
+            hashes[i] = hash;
+            offs[i] = off;
+        }
+        off += de->rec_len;
+    }
+
+    // Split near the middle, but never between two equal hashes
+    uint32_t mid = count / 2;
+    while (mid < count && mid > 0 && hashes[mid] == hashes[mid - 1]) mid++;
+    if (mid == count) {
+        mid = count / 2;
+        while (mid > 0 && hashes[mid] == hashes[mid - 1]) mid--;
+    }
+    if (mid == 0) return 0;  // Every name in the leaf hashes alike
+    *split_hash = hashes[mid];
+
+    // Only now that the leaf can be split is the new block worth adding
+    uint32_t new_lba = dir_append_block(dir, new_leaf);
+    if (!new_lba) return 0;
+    uint8_t* fresh = cache_get(new_lba);
+    if (!fresh) return 0;
+    block_init(fresh);
+    cache_write(new_lba);
+
+    block = cache_get(lba);
+    fresh = cache_get(new_lba);
+    if (!block || !fresh) return 0;
+    block_init(block);
+    for (uint32_t i = 0; i < count; i++) {
+        fs_disk_dirent_t* de = (fs_disk_dirent_t*)(copy + offs[i]);
+        block_insert(i < mid ? block : fresh, de->id, de->type, de->name, de->name_len);
+    }
+    cache_write(lba);
+    cache_write(new_lba);
+    return 1;
+}
+
+/**
+ * @brief Adds an entry to an indexed directory
+ * @return 1 on success, 0 on failure
+ */
+static int dx_add(fs_node_t* dir, uint32_t id, uint8_t type, const char* name, uint32_t len) {
+    uint32_t hash = fs_name_hash(name, len);
+    dx_frame_t frames[FS_DX_MAX_LEVELS];
+
+    // Each pass either inserts or changes the index shape by one step
+    for (int attempt = 0; attempt < 2 * FS_DX_MAX_LEVELS + 2; attempt++) {
+        uint32_t leaf;
+        uint32_t levels = dx_descend(dir, hash, frames, &leaf);
+        if (!levels) return 0;
+
+        uint32_t lba = bmap(dir, leaf, 0);
+        uint8_t* block = cache_get(lba);
+        if (!block) return 0;
+        if (block_insert(block, id, type, name, len)) {
+            cache_write(lba);
+            return 1;
+        }
+
+        // Leaf is full: make sure its parent can take another pointer,
+        // then split the leaf and link the new half in
+        int room = dx_make_room(dir, frames, levels - 1);
+        if (room == 0) return 0;
+        if (room == 2) continue;
+
+        uint32_t split_hash, new_leaf;
+        if (!dx_split_leaf(dir, leaf, &split_hash, &new_leaf)) return 0;
+
+        uint32_t parent_lba = bmap(dir, frames[levels - 1].block, 0);
+        block = cache_get(parent_lba);
+        if (!block) return 0;
+        dx_insert_entry(block, frames[levels - 1].pos + 1, split_hash, new_leaf);
+        cache_write(parent_lba);
+    }
+    return 0;
+}
+
+/**
+ * @brief Turns a linear directory into an indexed one
+ * Block 0's entries move to a new leaf and block 0 becomes the index
+ * root. Entries in any further blocks (directories written before the
+ * index existed) are re-inserted through the index.
+ * @return 1 on success, 0 on failure
+ */
+static int dx_convert(fs_node_t* dir) {
+    static uint8_t copy[SECTOR_SIZE];
+    uint32_t old_blocks = dir->size / SECTOR_SIZE;
+
+    uint32_t leaf_no;
+    uint32_t leaf_lba = dir_append_block(dir, &leaf_no);
+    if (!leaf_lba) return 0;
+
+    uint32_t root_lba = bmap(dir, 0, 0);
+    uint8_t* root = cache_get(root_lba);
+    uint8_t* leaf = cache_get(leaf_lba);
+    if (!root || !leaf) return 0;
+
+    memcpy(leaf, root, SECTOR_SIZE);
+    cache_write(leaf_lba);
+    dx_init_block(root, 1);
+    dx_insert_entry(root, 0, 0, leaf_no);
+    cache_write(root_lba);
+    dir->flags |= FS_FLAG_INDEXED;
+
+    for (uint32_t b = 1; b < old_blocks; b++) {
+        uint32_t lba = bmap(dir, b, 0);
+        uint8_t* block = cache_get(lba);
+        if (!block) continue;
+        memcpy(copy, block, SECTOR_SIZE);
+        block_init(block);
+        cache_write(lba);
+
+        uint32_t off = 0;
+        while (off < SECTOR_SIZE && dirent_valid(copy, off)) {
+            fs_disk_dirent_t* de = (fs_disk_dirent_t*)(copy + off);
+            if (de->id != 0 && !dx_add(dir, de->id, de->type, de->name, de->name_len)) {
+                return 0;
+            }
+            off += de->rec_len;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Finds the leaf holding a name in an indexed directory
+ * @return The leaf's LBA, or 0 if the index is unreadable
+ */
+static uint32_t dx_leaf_for(fs_node_t* dir, const char* name, uint32_t len) {
+    dx_frame_t frames[FS_DX_MAX_LEVELS];
+    uint32_t leaf;
+    if (!dx_descend(dir, fs_name_hash(name, len), frames, &leaf)) return 0;
+    return bmap(dir, leaf, 0);
+}
+
+/**
+ * @brief Looks a name up in a directory
+ * Indexed directories read only the index path and one leaf.
+ * @return The child's ID, or 0 if not found
+ */
+static uint32_t dir_lookup(fs_node_t* dir, const char* name, uint32_t len) {
+    if (len == 0 || len >= FS_MAX_NAME) return 0;
+
+    if (dir->flags & FS_FLAG_INDEXED) {
+        uint8_t* block = cache_get(dx_leaf_for(dir, name, len));
+        if (!block) return 0;
+        int off = block_find(block, name, len, 0);
+        return off >= 0 ? ((fs_disk_dirent_t*)(block + off))->id : 0;
+    }
+
+    uint32_t blocks = dir->size / SECTOR_SIZE;
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint8_t* block = cache_get(bmap(dir, b, 0));
+        if (!block) continue;
+        int off = block_find(block, name, len, 0);
+        if (off >= 0) {
+            return ((fs_disk_dirent_t*)(block + off))->id;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Adds an entry to a directory
+ * A linear directory fills its first block, then switches to the index.
+ * Updates dir (size, blocks, flags); the caller saves the node.
+ * @return 1 on success, 0 if no block could be allocated
+ */
+static int dir_add(fs_node_t* dir, uint32_t id, uint8_t type, const char* name) {
+    uint32_t len = strlen(name);
+    if (len >= FS_MAX_NAME) len = FS_MAX_NAME - 1;
+
+    if (dir->flags & FS_FLAG_INDEXED) {
+        return dx_add(dir, id, type, name, len);
+    }
+
+    uint32_t blocks = dir->size / SECTOR_SIZE;
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t lba = bmap(dir, b, 0);
+        uint8_t* block = cache_get(lba);
+        if (block && block_insert(block, id, type, name, len)) {
+            cache_write(lba);
+            return 1;
+        }
+    }
+
+    if (blocks > 0) {
+        return dx_convert(dir) && dx_add(dir, id, type, name, len);
+    }
+
+    uint32_t block_no;
+    uint32_t lba = dir_append_block(dir, &block_no);
+    uint8_t* block = cache_get(lba);
+    if (!block) return 0;
+
+    block_init(block);
+    block_insert(block, id, type, name, len);
+    cache_write(lba);
+    return 1;
+}
+
+/**
+ * @brief Removes the entry for (name, id) from a directory
+ * Indexed directories only touch the one leaf; leaves are never merged.
+ * @return 1 if an entry was removed
+ */
+static int dir_remove(fs_node_t* dir, uint32_t id, const char* name) {
+    uint32_t len = strlen(name);
+
+    if (dir->flags & FS_FLAG_INDEXED) {
+        uint32_t lba = dx_leaf_for(dir, name, len);
+        uint8_t* block = cache_get(lba);
+        if (block) {
+            int off = block_find(block, 0, 0, id);
+            if (off >= 0) {
+                block_remove(block, off);
+                cache_write(lba);
+                return 1;
+            }
+        }
+    }
+
+    uint32_t blocks = dir->size / SECTOR_SIZE;
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t lba = bmap(dir, b, 0);
+        uint8_t* block = cache_get(lba);
+        if (!block) continue;
+        int off = block_find(block, 0, 0, id);
+        if (off >= 0) {
+            block_remove(block, off);
+            cache_write(lba);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// --- Path Lookup Cache ---
+// Every change to a directory's entries goes through create_node() or
+// fs_delete_node(), which update the matching slot; a reformat flushes all.
+
+static fs_dcache_entry_t* dcache_slot(uint32_t parent_id, const char* name, uint32_t len) {
+    uint32_t hash = fs_name_hash(name, len) ^ (parent_id * 2654435761u);
+    return &dcache[hash % FS_DCACHE_SIZE];
+}
+
+static void dcache_set(uint32_t parent_id, const char* name, uint32_t len, uint32_t child_id) {
+    fs_dcache_entry_t* e = dcache_slot(parent_id, name, len);
+    e->parent_id = parent_id;
+    e->child_id = child_id;
+    e->name_len = len;
+    memcpy(e->name, name, len);
+}
+
+static void dcache_flush() {
+    memset(dcache, 0, sizeof(dcache));
+}
+
+/**
+ * @brief Resolves one path component, consulting the dcache first
+ * @return The child's ID, or 0 if not found
+ */
+static uint32_t lookup_child(uint32_t parent_id, const char* name, uint32_t len) {
+    if (len == 0 || len >= FS_MAX_NAME) return 0;
+
+    fs_dcache_entry_t* e = dcache_slot(parent_id, name, len);
+    if (e->parent_id == parent_id && e->name_len == len && memcmp(e->name, name, len) == 0) {
+        dcache_hits++;
+        return e->child_id;
+    }
+    dcache_misses++;
+
+    fs_node_t* parent = fs_get_node(parent_id);  // Lazy loads parent
+    if (!parent || parent->type != FS_TYPE_DIRECTORY) return 0;
+
+    // Only the directory's own blocks are read, never the children
+    fs_node_t dir = *parent;
+    uint32_t id = dir_lookup(&dir, name, len);
+    dcache_set(parent_id, name, len, id);
+    return id;
+}
+
+/**
+ * @brief Creates a node and links it into its parent
+ * @return The new node's ID, or 0 on failure
+ */
+static uint32_t create_node(uint32_t parent_id, const char* name, uint8_t type) {
+    uint32_t len = strlen(name);
+    if (len == 0 || len >= FS_MAX_NAME) {
+        return 0;  // Empty, or too long to be stored whole
+    }
+    if (lookup_child(parent_id, name, len) != 0) {
+        return 0;  // Name already taken
+    }
+    fs_node_t* parent_slot = fs_get_node(parent_id);  // Lazy load parent
+    if (!parent_slot || parent_slot->type != FS_TYPE_DIRECTORY) return 0;
+    fs_node_t parent = *parent_slot;
+
+    uint32_t new_id = bitmap_alloc(&inode_map, 0);
+    if (new_id == 0) {
+        console_print_colored("FS: Disk full.\n", COLOR_LIGHT_RED);
+        return 0;
+    }
+    sb.next_free_id = inode_map.hint * 32;
+    sb.total_nodes++;
+
+    fs_node_t node;
+    memset(&node, 0, sizeof(fs_node_t));
+    node.id = new_id;
+    node.parent_id = parent_id;
+    node.type = type;
+    strncpy(node.name, name, FS_MAX_NAME - 1);
+    node.name[FS_MAX_NAME - 1] = '\0';
+    save_node(new_id, &node);
+
+    // Link it into the parent directory
+    if (!dir_add(&parent, new_id, type, node.name)) {
+        bitmap_clear(&inode_map, new_id);
+        sb.total_nodes--;
+        return 0;
+    }
+    parent.child_count++;
+    save_node(parent_id, &parent);
+    dcache_set(parent_id, node.name, len, new_id);
+
+    save_superblock();
+    return new_id;
+}
+
+/**
+ * @brief Loads both allocation bitmaps described by the superblock
+ * @return 1 on success, 0 if they could not be loaded
+ */
+static int load_bitmaps() {
+    if (!bitmap_setup(&inode_map, sb.inode_bitmap_start, sb.inode_bitmap_sectors, sb.max_nodes) ||
+        !bitmap_setup(&block_map, sb.block_bitmap_start, sb.block_bitmap_sectors, sb.total_sectors)) {
+        console_print_colored("FS: Out of memory for bitmaps.\n", COLOR_LIGHT_RED);
+        return 0;
+    }
+
+    bitmap_transfer(&inode_map, 0);
+    bitmap_transfer(&block_map, 0);
+    bitmap_finish(&inode_map);
+    bitmap_finish(&block_map);
+
+    inode_map.hint = sb.next_free_id / 32;
+    block_map.hint = sb.next_free_lba / 32;
+
+    // The bitmaps are authoritative; the counters may lag a crash
+    sb.total_nodes = inode_map.bits - inode_map.free - 1;  // Minus inode 0
+    sb.used_sectors = block_map.bits - block_map.free;
+    return 1;
+}
+
+// --- Initial Tree ---
+// What mkfs puts on a fresh disk. Parents must be listed before their
+// children; files get their text as contents.
+typedef struct {
+    const char* path;       // Relative to the root
+    uint8_t     type;
+    const char* text;
+} fs_seed_t;
+
+static const fs_seed_t seed_tree[] = {
+    { "bin",  FS_TYPE_DIRECTORY, 0 },   // Essential user commands
+    { "boot", FS_TYPE_DIRECTORY, 0 },   // Boot files (informational)
+    { "dev",  FS_TYPE_DIRECTORY, 0 },   // devfs mount point
+    { "etc",  FS_TYPE_DIRECTORY, 0 },   // System configuration
+    { "home", FS_TYPE_DIRECTORY, 0 },   // User home directories
+    { "lib",  FS_TYPE_DIRECTORY, 0 },   // Shared libraries (future)
+    { "mnt",  FS_TYPE_DIRECTORY, 0 },   // Mount points
+    { "opt",  FS_TYPE_DIRECTORY, 0 },   // Optional software
+    { "proc", FS_TYPE_DIRECTORY, 0 },   // procfs mount point
+    { "root", FS_TYPE_DIRECTORY, 0 },   // Root user home
+    { "sbin", FS_TYPE_DIRECTORY, 0 },   // System binaries
+    { "sys",  FS_TYPE_DIRECTORY, 0 },   // System info (future)
+    { "tmp",  FS_TYPE_DIRECTORY, 0 },   // Temporary files
+    { "usr",  FS_TYPE_DIRECTORY, 0 },   // User programs
+    { "var",  FS_TYPE_DIRECTORY, 0 },   // Variable data
+    { "a",    FS_TYPE_DIRECTORY, 0 },   // User workspace
+    { "h",    FS_TYPE_DIRECTORY, 0 },   // Command history
+    { "boot/version", FS_TYPE_FILE,
+        "PUNIX Kernel v1.03\n"
+        "Build: 2024-12-01\n"
+        "Architecture: x86 (32-bit)\n" },
+    { "boot/README", FS_TYPE_FILE,
+        "Boot Directory\n"
+        "==============\n\n"
+        "This directory contains system information.\n"
+        "The actual bootloader and kernel are stored\n"
+        "in fixed disk sectors, not in the filesystem.\n\n"
+        "Bootloader: Sector 0 (512 bytes)\n"
+        "Kernel:     Sectors 256-511 (up to 128 KB)\n" },
+    { "etc/motd", FS_TYPE_FILE,
+        "Welcome to PUNIX!\n"
+        "Type 'help' for available commands.\n" },
+};
+
+#define SEED_COUNT (sizeof(seed_tree) / sizeof(seed_tree[0]))
+
+/**
+ * @brief Writes a run of sectors in FS_IO_CHUNK pieces
+ */
+static void write_run(uint32_t lba, uint32_t sectors, uint8_t* buf) {
+    for (uint32_t done = 0; done < sectors; done += FS_IO_CHUNK) {
+        uint32_t count = sectors - done;
+        if (count > FS_IO_CHUNK) count = FS_IO_CHUNK;
+        ata_write_sectors(lba + done, count, buf + done * SECTOR_SIZE);
+    }
+}
+
+/**
+ * @brief Finds the node ID of a seed's parent directory
+ * Seed i has ID i + 2 (the root is 1).
+ */
+static uint32_t seed_parent(const fs_seed_t* seeds, uint32_t index, const char** name) {
+    const char* path = seeds[index].path;
+    const char* slash = 0;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/') slash = p;
+    }
+    if (!slash) {
+        *name = path;
+        return FS_ROOT_ID;
+    }
+
+    *name = slash + 1;
+    uint32_t len = slash - path;
+    for (uint32_t i = 0; i < index; i++) {
+        if (seeds[i].type == FS_TYPE_DIRECTORY && (uint32_t)strlen(seeds[i].path) == len &&
+            memcmp(seeds[i].path, path, len) == 0) {
+            return i + 2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Lays out the bitmaps and inode table for the whole disk and
+ * writes the root plus the given tree. The inodes and data blocks are
+ * built in memory and go out in a few multi-sector writes, as do the
+ * bitmaps. The superblock is written by the caller.
+ * @return 1 on success, 0 if out of memory
+ */
+static int format_layout(const fs_seed_t* seeds, uint32_t count) {
+    memset(cache, 0, sizeof(cache));
+    dcache_flush();
+    memset(&sb, 0, sizeof(sb));
+    memset(&refs_node, 0, sizeof(refs_node));
+
+    uint32_t total = ata_get_sector_count();
+    if (total == 0) total = FS_DISK_SECTORS;
+
+    // Inode count scales with the disk instead of a fixed constant
+    uint32_t max_nodes = total / FS_SECTORS_PER_INODE;
+    max_nodes -= max_nodes % FS_INODES_PER_SECTOR;
+
+    sb.magic = FS_MAGIC;
+    sb.version = FS_VERSION;
+    sb.root_id = FS_ROOT_ID;
+    sb.max_nodes = max_nodes;
+    sb.total_sectors = total;
+    sb.inode_bitmap_start = FS_LAYOUT_START;
+    sb.inode_bitmap_sectors = (max_nodes + FS_BITS_PER_SECTOR - 1) / FS_BITS_PER_SECTOR;
+    sb.block_bitmap_start = sb.inode_bitmap_start + sb.inode_bitmap_sectors;
+    sb.block_bitmap_sectors = (total + FS_BITS_PER_SECTOR - 1) / FS_BITS_PER_SECTOR;
+    sb.inode_table_start = sb.block_bitmap_start + sb.block_bitmap_sectors;
+    sb.inode_table_sectors = max_nodes / FS_INODES_PER_SECTOR;
+    sb.data_start = sb.inode_table_start + sb.inode_table_sectors;
+    sb.next_free_id = 0;
+
+    // One entry block per non-empty directory, then the file contents
+    uint32_t last_id = count + 1;
+    uint32_t inode_sectors = last_id / FS_INODES_PER_SECTOR + 1;
+    uint32_t data_sectors = count > 0 ? 1 : 0;  // Root's entry block
+    for (uint32_t i = 0; i < count; i++) {
+        if (seeds[i].type == FS_TYPE_FILE && seeds[i].text) {
+            uint32_t blocks = (strlen(seeds[i].text) + SECTOR_SIZE - 1) / SECTOR_SIZE;
+            data_sectors += blocks < FS_DIRECT_BLOCKS ? blocks : FS_DIRECT_BLOCKS;
+        } else if (seeds[i].type == FS_TYPE_DIRECTORY) {
+            for (uint32_t j = i + 1; j < count; j++) {
+                const char* name;
+                if (seed_parent(seeds, j, &name) == i + 2) {
+                    data_sectors++;
+                    break;
+                }
+            }
+        }
+    }
+
+    uint32_t pages = ((inode_sectors + data_sectors) * SECTOR_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint8_t* buf = (uint8_t*)pmm_alloc_pages(pages);
+    if (!buf || !bitmap_setup(&inode_map, sb.inode_bitmap_start, sb.inode_bitmap_sectors, max_nodes) ||
+        !bitmap_setup(&block_map, sb.block_bitmap_start, sb.block_bitmap_sectors, total)) {
+        console_print_colored("FS: Out of memory for formatting.\n", COLOR_LIGHT_RED);
+        for (uint32_t i = 0; buf && i < pages; i++) {
+            pmm_free_page(buf + i * PAGE_SIZE);
+        }
+        return 0;
+    }
+
+    fs_node_t* nodes = (fs_node_t*)buf;
+    uint8_t* data = buf + inode_sectors * SECTOR_SIZE;
+    uint32_t next_lba = sb.data_start;
+
+    nodes[FS_ROOT_ID].id = FS_ROOT_ID;
+    nodes[FS_ROOT_ID].parent_id = FS_ROOT_ID;
+    nodes[FS_ROOT_ID].type = FS_TYPE_DIRECTORY;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const char* name;
+        uint32_t parent = seed_parent(seeds, i, &name);
+        fs_node_t* node = &nodes[i + 2];
+        node->id = i + 2;
+        node->parent_id = parent;
+        node->type = seeds[i].type;
+        strncpy(node->name, name, FS_MAX_NAME - 1);
+
+        if (node->type == FS_TYPE_FILE && seeds[i].text) {
+            uint32_t len = strlen(seeds[i].text);
+            if (len > FS_DIRECT_BLOCKS * SECTOR_SIZE) len = FS_DIRECT_BLOCKS * SECTOR_SIZE;
+            memcpy(data + (next_lba - sb.data_start) * SECTOR_SIZE, seeds[i].text, len);
+            node->size = len;
+            for (uint32_t b = 0; b * SECTOR_SIZE < len; b++) {
+                node->direct[node->blocks++] = next_lba++;
+            }
+        }
+
+        // Link it into its parent, giving the parent its block on first use
+        fs_node_t* dir = &nodes[parent];
+        if (dir->blocks == 0) {
+            dir->direct[0] = next_lba++;
+            dir->blocks = 1;
+            dir->size = SECTOR_SIZE;
+            block_init(data + (dir->direct[0] - sb.data_start) * SECTOR_SIZE);
+        }
+        uint8_t* block = data + (dir->direct[0] - sb.data_start) * SECTOR_SIZE;
+        if (block_insert(block, node->id, node->type, node->name, strlen(node->name))) {
+            dir->child_count++;
+        }
+    }
+
+    sb.total_nodes = last_id;
+    sb.used_sectors = next_lba;  // boot + kernel + superblock + tables + tree
+    sb.next_free_lba = next_lba;
+
+    memset(inode_map.map, 0, inode_map.sectors * SECTOR_SIZE);
+    memset(block_map.map, 0, block_map.sectors * SECTOR_SIZE);
+
+    // Inode 0 is "no node"; everything before the free space is in use
+    for (uint32_t i = 0; i <= last_id; i++) {
+        inode_map.map[i / 32] |= 1u << (i % 32);
+    }
+    for (uint32_t i = 0; i < next_lba; i++) {
+        block_map.map[i / 32] |= 1u << (i % 32);
+    }
+    bitmap_finish(&inode_map);
+    bitmap_finish(&block_map);
+    block_map.hint = next_lba / 32;
+
+    bitmap_transfer(&inode_map, 1);
+    bitmap_transfer(&block_map, 1);
+    write_run(sb.inode_table_start, inode_sectors, buf);
+    write_run(sb.data_start, next_lba - sb.data_start, data);
+
+    for (uint32_t i = 0; i < pages; i++) {
+        pmm_free_page(buf + i * PAGE_SIZE);
+    }
+    return 1;
+}
+
+void fs_commit() {
+    journal_commit();
+}
+
+int fs_sync_node(uint32_t id, int datasync) {
+    if (id == 0 || id >= sb.max_nodes) return -1;
+    if (!journal.active) return 0;  // Everything was written through
+
+    // The group commits as a whole; its flush covers the data as well
+    int commit = datasync ? journal_find(INODE_SECTOR(id)) != 0
+                          : (journal.count > 0 || sb_dirty);
+    if (commit) return journal_commit();
+
+    if (!data_unflushed) return 0;
+    data_unflushed = 0;
+    return ata_flush();
+}
+
+/**
+ * @brief Flushes all dirty sectors to disk
+ */
+void fs_sync() {
+    for (int i = 0; i < FS_CACHE_SIZE; i++) {
+        if (cache[i].lba != 0 && cache[i].dirty) {
+            write_meta(cache[i].lba, cache[i].data);
+            cache[i].dirty = 0;
+        }
+    }
+    journal_commit();
+    console_print_colored("FS: Cache synced to disk.\n", COLOR_GREEN_ON_BLACK);
+}
+
+// Formats the disk
+static void mkfs() {
+    console_print_colored("FS: Formatting drive...\n", COLOR_YELLOW_ON_BLACK);
+
+    if (!format_layout(seed_tree, SEED_COUNT)) return;
+    save_superblock();
+
+    console_print_colored("FS: Format complete. ", COLOR_GREEN_ON_BLACK);
+    console_print_colored("Standard directory structure created.\n", COLOR_GREEN_ON_BLACK);
+}
+
+/**
+ * @brief Converts a v1 disk (one node per sector) to the current format.
+ * The v1 node table (LBA 62-189) does not overlap the new layout, so the
+ * old tree is read while the new one is built. The superblock is written
+ * last: an interrupted conversion simply restarts on the next boot.
+ */
+static void convert_v1() {
+    console_print_colored("FS: Converting v1 filesystem...\n", COLOR_YELLOW_ON_BLACK);
+
+    uint32_t v1_next_id = sb.next_free_id;
+    if (v1_next_id > FS_V1_MAX_NODES) v1_next_id = FS_V1_MAX_NODES;
+
+    converting = 1;
+    if (!format_layout(0, 0)) {
+        converting = 0;
+        return;
+    }
+
+    // Breadth-first walk: (old id, new parent id) pairs
+    static uint32_t queue_old[FS_V1_MAX_NODES];
+    static uint32_t queue_parent[FS_V1_MAX_NODES];
+    static uint8_t sector[SECTOR_SIZE];
+    fs_node_v1_t* old = (fs_node_v1_t*)sector;
+    uint32_t head = 0, tail = 0, converted = 1;
+
+    if (ata_read_sectors(V1_NODE_SECTOR(FS_ROOT_ID), 1, sector) == 0 &&
+        old->id == FS_ROOT_ID) {
+        uint32_t* ids = old->child_ids;  // May run on into padding
+        for (uint32_t i = 0; i < old->child_count && i < FS_V1_CHILD_SLOTS; i++) {
+            queue_old[tail] = ids[i];
+            queue_parent[tail] = FS_ROOT_ID;
+            tail++;
+        }
+    }
+
+    while (head < tail) {
+        uint32_t old_id = queue_old[head];
+        uint32_t parent_id = queue_parent[head];
+        head++;
+
+        if (old_id == 0 || old_id >= v1_next_id) continue;
+        if (ata_read_sectors(V1_NODE_SECTOR(old_id), 1, sector) != 0) continue;
+        if (old->id != old_id) continue;
+        old->name[FS_MAX_NAME - 1] = '\0';
+
+        uint32_t new_id = create_node(parent_id, old->name, old->type);
+        if (new_id == 0) continue;
+        converted++;
+
+        if (old->type == FS_TYPE_FILE) {
+            uint32_t size = old->size;
+            if (size > sizeof(old->padding)) size = sizeof(old->padding);
+            fs_node_t* file = fs_get_node(new_id);
+            if (file && size > 0) {
+                fs_write(file, 0, old->padding, size);
+            }
+        } else {
+            for (uint32_t i = 0; i < old->child_count && i < FS_V1_MAX_CHILDREN; i++) {
+                if (tail >= FS_V1_MAX_NODES) break;
+                queue_old[tail] = old->child_ids[i];
+                queue_parent[tail] = new_id;
+                tail++;
+            }
+        }
+    }
+
+    converting = 0;
+    save_superblock();
+
+    char num[12];
+    int_to_str(converted, num);
+    console_print_colored("FS: Converted ", COLOR_GREEN_ON_BLACK);
+    console_print(num);
+    console_print(" nodes to format v");
+    int_to_str(FS_VERSION, num);
+    console_print(num);
+    console_print(".\n");
+}
+
+// --- Public API ---
+
+/**
+ * @brief Reports a disk this kernel cannot read. Nothing is mounted and
+ * nothing is written: no inode is valid, so every lookup and create
+ * fails before touching the disk.
+ * @param what What is not supported, e.g. "Filesystem version 3"
+ */
+static void refuse_mount(const char* what) {
+    console_print_colored("FS: ", COLOR_LIGHT_RED);
+    console_print_colored(what, COLOR_LIGHT_RED);
+    console_print_colored(" is not supported; the disk is left untouched.\n", COLOR_LIGHT_RED);
+    journal.active = 0;
+}
+
+/**
+ * @brief Tells whether a disk keeps its bitmaps where the kernel now
+ * lives (formatted before the kernel area was reserved)
+ */
+static int layout_in_kernel_area() {
+    return sb.version >= FS_MIN_VERSION && sb.version <= FS_VERSION &&
+           sb.inode_bitmap_start < FS_LAYOUT_START;
+}
+
+void fs_init() {
+    // Initialize cache
+    memset(cache, 0, sizeof(cache));
+    access_counter = 0;
+    dcache_flush();
+
+    int journaled = journal_setup();
+    sb_dirty = 0;
+
+    // Read Superblock ONLY (not all nodes!)
+    ata_read_sectors(FS_SUPERBLOCK_SECTOR, 1, &sb);
+
+    if (sb.magic == FS_MAGIC && sb.version >= 6 && sb.version <= FS_VERSION &&
+        !layout_in_kernel_area()) {
+        // Finish the last committed group before trusting any metadata
+        journal_replay();
+        ata_read_sectors(FS_SUPERBLOCK_SECTOR, 1, &sb);
+    }
+
+    if (sb.magic != FS_MAGIC) {
+        console_print_colored("FS: No filesystem detected.\n", COLOR_LIGHT_RED);
+        mkfs();
+        journal_reset();
+    } else if (sb.version == 0) {
+        convert_v1();
+        journal_reset();
+    } else if (sb.version < FS_MIN_VERSION || sb.version > FS_VERSION) {
+        // v2/v3 (child ID directories) and newer disks: never format over
+        // a recognised filesystem, leave it unmounted
+        char what[32];
+        strcpy(what, "Filesystem version ");
+        int_to_str(sb.version, what + strlen(what));
+        refuse_mount(what);
+        return;
+    } else if (layout_in_kernel_area()) {
+        // Its bitmaps share LBA 256+ with the kernel image: mounting it
+        // would write one over the other
+        refuse_mount("A disk with bitmaps in the kernel area (LBA 256-511)");
+        return;
+    } else if (!load_bitmaps()) {
+        return;
+    } else {
+        if (sb.version != FS_VERSION) {
+            // Older kernels know neither indexed directories nor the journal
+            if (sb.version < 6) journal_reset();
+            if (sb.version < 7) {
+                memset(&refs_node, 0, sizeof(refs_node));  // No shared blocks
+                refs_save();
+            }
+            sb.version = FS_VERSION;
+            save_superblock();
+        }
+        console_print_colored("FS: Filesystem mounted (lazy loading enabled).\n", COLOR_GREEN_ON_BLACK);
+        // NOTE: We DON'T load all nodes here anymore!
+        // They will be loaded on-demand when accessed
+    }
+
+    refs_load();
+    journal.active = journaled;
+    fs_root_id = FS_ROOT_ID;
+
+    // Load root and /a into cache for initial access
+    fs_get_node(FS_ROOT_ID);
+
+    fs_node_t* dir_a = fs_find_node("a", fs_root_id);
+    if (dir_a && dir_a->type == FS_TYPE_DIRECTORY) {
+        fs_current_dir_id = dir_a->id;
+        console_print_colored("FS: Working directory set to /a.\n", COLOR_GREEN_ON_BLACK);
+    } else {
+        fs_current_dir_id = fs_root_id;
+    }
+}
+
+// Get node - now uses cache with lazy loading!
+fs_node_t* fs_get_node(uint32_t id) {
+    if (id == 0 || !inode_map.map || !bitmap_test(&inode_map, id)) {
+        return 0;  // Free ID (checked in RAM, no disk access)
+    }
+
+    fs_node_t* node = inode_slot(id);  // Loads the inode sector if needed
+    if (!node || node->id != id) {
+        return 0;  // Free slot or disk corruption
+    }
+    return node;
+}
+
+int fs_update_node(fs_node_t* node) {
+    if (!node || node->id == 0) return 0;
+    journal_begin();
+    save_node(node->id, node);
+    journal_end();
+    return 1;
+}
+
+int fs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count) {
+    if (!node || node->id == 0) return -1;
+
+    // Work on a copy: cache slots may be recycled while we read
+    fs_node_t n = *node;
+    if (offset >= n.size) return 0;
+    if (count > n.size - offset) count = n.size - offset;
+
+    uint8_t* out = (uint8_t*)buf;
+    uint32_t done = 0;
+
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t in_block = pos % SECTOR_SIZE;
+        uint32_t chunk = SECTOR_SIZE - in_block;
+        if (chunk > count - done) chunk = count - done;
+
+        uint32_t lba = bmap(&n, pos / SECTOR_SIZE, 0);
+        if (lba == 0) {
+            memset(out + done, 0, chunk);  // Hole
         } else {
-            next_component = 0;
+            uint8_t* data = cache_get(lba);
+            if (!data) return done > 0 ? (int)done : -1;
+            memcpy(out + done, data + in_block, chunk);
         }
 
-        if (strlen(component) > 0) {
-            if (strcmp(component, "..") == 0) {
-                fs_node_t* cur = fs_get_node(current_id);  // Lazy load
-                if (cur) current_id = cur->parent_id;
-            }
-            else if (strcmp(component, ".") == 0) {
-                // Do nothing
+        done += chunk;
+    }
+
+    return done;
+}
+
+int fs_write(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count) {
+    if (!node || node->id == 0) return -1;
+    if (count == 0) return 0;
+
+    // Start from the inode itself; the caller's copy may be out of date
+    fs_node_t* cur = fs_get_node(node->id);
+    if (!cur) return -1;
+    fs_node_t n = *cur;
+    uint32_t old_used = sb.used_sectors;
+    journal_begin();
+    uint32_t done = write_data(&n, offset, buf, count);
+    pcache_update(n.id, offset, buf, done);
+
+    // An overwrite in place leaves the inode as it was: keep it out of the
+    // journal, so fs_sync_node() can tell the data alone needs flushing
+    fs_node_t* slot = inode_slot(n.id);
+    if (!slot || sb.used_sectors != old_used || memcmp(slot, &n, sizeof(fs_node_t)) != 0) {
+        save_node(n.id, &n);
+    }
+    if (sb.used_sectors != old_used) {
+        save_superblock();
+    }
+    journal_end();
+
+    return done > 0 ? (int)done : -1;
+}
+
+/**
+ * @brief Copies whole sectors from src to dst with multi-sector transfers
+ * Runs that are contiguous on both sides move in one read and one write.
+ * Source holes stay holes unless dst already has a block there.
+ * @return Bytes copied (a multiple of SECTOR_SIZE)
+ */
+static uint32_t copy_sectors(fs_node_t* src, uint32_t src_off, fs_node_t* dst, uint32_t dst_off, uint32_t count) {
+    uint32_t done = 0;
+
+    while (count - done >= SECTOR_SIZE) {
+        uint32_t sblock = (src_off + done) / SECTOR_SIZE;
+        uint32_t dblock = (dst_off + done) / SECTOR_SIZE;
+        uint32_t left = (count - done) / SECTOR_SIZE;
+        if (left > FS_IO_CHUNK) left = FS_IO_CHUNK;
+
+        uint32_t slba = bmap(src, sblock, 0);
+        if (slba == 0) {
+            uint32_t dlba = bmap(dst, dblock, 0);
+            if (dlba && block_refs(dlba)) {
+                dlba = unshare_block(dst, dblock, dlba, 1);
             }
-            else {
-                uint32_t next_id = fs_find_node_local_id(current_id, component);
-                if (next_id == 0) return 0;
-                current_id = next_id;
+            if (dlba) {
+                cache_get_zeroed(dlba);
+                cache_write_data(dlba);
             }
+            done += SECTOR_SIZE;
+            continue;
+        }
+
+        uint32_t dlba = bmap(dst, dblock, 1);
+        if (dlba != 0 && block_refs(dlba)) {
+            dlba = unshare_block(dst, dblock, dlba, 1);
+        }
+        if (dlba == 0) {
+            console_print_colored("FS: Disk full.\n", COLOR_LIGHT_RED);
+            break;
+        }
+        // Every block of the run is overwritten: drop its cached copy
+        // (stale, or freshly zeroed) instead of writing it back
+        cache_drop(dlba);
+        uint32_t run = 1;
+        while (run < left && bmap(src, sblock + run, 0) == slba + run) {
+            uint32_t next = bmap(dst, dblock + run, 1);
+            if (next != dlba + run || block_refs(next)) break;
+            cache_drop(next);
+            run++;
         }
 
-        if (!next_component) break;
-        component = next_component;
+        if (ata_read_sectors(slba, run, copy_buf) != 0) break;
+        if (journal.active) {
+            ata_write_sectors_noflush(dlba, run, copy_buf);
+            data_unflushed = 1;
+        } else {
+            ata_write_sectors(dlba, run, copy_buf);
+        }
+        pcache_update(dst->id, dst_off + done, copy_buf, run * SECTOR_SIZE);
+        done += run * SECTOR_SIZE;
     }
 
-    return fs_get_node(current_id);  // Lazy load final node
+    if (dst_off + done > dst->size) {
+        dst->size = dst_off + done;
+    }
+    return done;
 }
 
-int fs_create_node(uint32_t parent_id, char* name, uint8_t type) {
-    if (sb.next_free_id >= FS_MAX_NODES) {
-        console_print_colored("FS: Disk full.\n", COLOR_LIGHT_RED);
-        return 0;
+int fs_copy_range(const fs_node_t* src, uint32_t src_off, const fs_node_t* dst, uint32_t dst_off, uint32_t count) {
+    if (!src || !dst || src->id == 0 || dst->id == 0) return -1;
+    if (src->type != FS_TYPE_FILE || dst->type != FS_TYPE_FILE) return -1;
+
+    fs_node_t s = *src;
+    fs_node_t d = *dst;
+    if (src_off >= s.size) return 0;
+    if (count > s.size - src_off) count = s.size - src_off;
+    if (s.id == d.id && src_off < dst_off + count && dst_off < src_off + count) {
+        return -1;  // Overlapping ranges of one file
     }
 
-    fs_node_t* parent = fs_get_node(parent_id);  // Lazy load parent
-    if (!parent || parent->type != FS_TYPE_DIRECTORY) return 0;
-    if (parent->child_count >= 16) {
-        console_print_colored("FS: Directory full.\n", COLOR_LIGHT_RED);
-        return 0;
+    if (!copy_buf) {
+        copy_buf = (uint8_t*)pmm_alloc_pages(FS_IO_CHUNK * SECTOR_SIZE / PAGE_SIZE);
+        if (!copy_buf) return -1;
     }
 
-    uint32_t new_id = sb.next_free_id++;
-    sb.total_nodes++;
-    sb.used_sectors++;
-    save_superblock();
+    uint32_t old_used = sb.used_sectors;
+    uint32_t done = 0;
+    journal_begin();
+
+    while (done < count) {
+        uint32_t chunk = count - done;
+        if ((src_off + done) % SECTOR_SIZE == 0 && (dst_off + done) % SECTOR_SIZE == 0 &&
+            chunk >= SECTOR_SIZE) {
+            uint32_t moved = copy_sectors(&s, src_off + done, &d, dst_off + done, chunk);
+            done += moved;
+            if (moved == 0) break;
+            continue;
+        }
 
-    // Create new node in cache
-    int slot = cache_find_slot();
-    fs_node_t* node = &cache[slot].node;
-
-    memset(node, 0, sizeof(fs_node_t));
-    node->id = new_id;
-    node->parent_id = parent_id;
-    node->type = type;
-    strncpy(node->name, name, 63);
-    node->name[63] = '\0';
-    node->size = 0;
-    node->child_count = 0;
+        // Unaligned: through the cache, one buffer at a time
+        if (chunk > FS_IO_CHUNK * SECTOR_SIZE) chunk = FS_IO_CHUNK * SECTOR_SIZE;
+        int got = fs_read(&s, src_off + done, copy_buf, chunk);
+        if (got <= 0) break;
+        uint32_t put = write_data(&d, dst_off + done, copy_buf, got);
+        pcache_update(d.id, dst_off + done, copy_buf, put);
+        done += put;
+        if (put < (uint32_t)got) break;
+    }
 
-    cache[slot].id = new_id;
-    cache[slot].dirty = 1;
-    cache[slot].last_access = ++access_counter;
+    save_node(d.id, &d);
+    if (sb.used_sectors != old_used) {
+        save_superblock();
+    }
+    journal_end();
 
-    parent->child_ids[parent->child_count++] = new_id;
-    cache_mark_dirty(parent_id);
+    return done;
+}
 
-    save_node(new_id);
-    save_node(parent_id);
+/**
+ * @brief Shares a file's data blocks with a freshly created node
+ * Blocks whose count is saturated are copied instead.
+ * @return 1 on success, 0 if the disk filled up
+ */
+static int clone_data(const fs_node_t* src, fs_node_t* dst) {
+    static uint8_t data[SECTOR_SIZE];
+    fs_node_t s = *src;
+    uint32_t blocks = (s.size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t lba = bmap(&s, b, 0);
+        if (lba == 0) continue;  // Hole
+
+        if (block_ref_adjust(lba, 1)) {
+            if (!bmap_set(dst, b, lba)) {
+                block_ref_adjust(lba, -1);
+                return 0;
+            }
+            dst->blocks++;
+            continue;
+        }
 
+        uint32_t copy = bmap(dst, b, 1);
+        uint8_t* old = cache_get(lba);
+        if (!copy || !old) return 0;
+        memcpy(data, old, SECTOR_SIZE);
+        uint8_t* fresh = cache_get(copy);
+        if (!fresh) return 0;
+        memcpy(fresh, data, SECTOR_SIZE);
+        cache_write_data(copy);
+    }
+    dst->size = s.size;
     return 1;
 }
 
-int fs_delete_node(uint32_t id) {
-    fs_node_t* node = fs_get_node(id);  // Lazy load
-    if (!node) return 0;
+/**
+ * @brief Clones a node (and, for a directory, everything below it)
+ * @return The clone's ID, or 0 on failure
+ */
+static uint32_t clone_node(uint32_t src_id, uint32_t parent_id, const char* name) {
+    fs_node_t* slot = fs_get_node(src_id);
+    if (!slot) return 0;
+    uint8_t type = slot->type;
+
+    uint32_t new_id = create_node(parent_id, name, type);
+    if (new_id == 0) return 0;
+
+    if (type == FS_TYPE_FILE) {
+        slot = fs_get_node(src_id);
+        fs_node_t* fresh = fs_get_node(new_id);
+        if (!slot || !fresh) return 0;
+        fs_node_t src = *slot;
+        fs_node_t node = *fresh;
+        int ok = clone_data(&src, &node);
+        save_node(new_id, &node);
+        return ok ? new_id : 0;
+    }
 
-    if (node->type == FS_TYPE_DIRECTORY && node->child_count > 0) {
-        return 0;
+    uint32_t cursor = 0;
+    fs_dirent_t entry;
+    while (fs_readdir(src_id, &cursor, &entry)) {
+        if (!clone_node(entry.id, new_id, entry.name)) return 0;
+    }
+    return new_id;
+}
+
+int fs_clone(uint32_t src_id, uint32_t parent_id, const char* name) {
+    // A tree cannot be cloned into itself
+    for (uint32_t id = parent_id; ; ) {
+        if (id == src_id) return 0;
+        fs_node_t* node = fs_get_node(id);
+        if (!node || id == FS_ROOT_ID) break;
+        id = node->parent_id;
     }
 
-    fs_node_t* parent = fs_get_node(node->parent_id);  // Lazy load parent
-    if (parent) {
-        int found = 0;
-        for (uint32_t i = 0; i < parent->child_count; i++) {
-            if (parent->child_ids[i] == id) {
-                for (uint32_t j = i; j < parent->child_count - 1; j++) {
-                    parent->child_ids[j] = parent->child_ids[j+1];
-                }
-                parent->child_count--;
-                found = 1;
-                break;
-            }
+    journal_begin();
+    uint32_t id = clone_node(src_id, parent_id, name);
+    save_superblock();
+    journal_end();
+    return id != 0;
+}
+
+int fs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out) {
+    fs_node_t* slot = fs_get_node(dir_id);
+    if (!slot || slot->type != FS_TYPE_DIRECTORY) return 0;
+    fs_node_t dir = *slot;
+
+    // The cursor is a byte offset into the directory's blocks
+    while (*cursor < dir.size) {
+        uint32_t off = *cursor % SECTOR_SIZE;
+        uint8_t* block = cache_get(bmap(&dir, *cursor / SECTOR_SIZE, 0));
+        if (!block || !dirent_valid(block, off)) {
+            *cursor = (*cursor / SECTOR_SIZE + 1) * SECTOR_SIZE;  // Skip bad block
+            continue;
         }
-        if (found) {
-            cache_mark_dirty(parent->id);
-            save_node(parent->id);
+
+        fs_disk_dirent_t* de = (fs_disk_dirent_t*)(block + off);
+        *cursor += de->rec_len;
+
+        if (de->id != 0) {
+            out->id = de->id;
+            out->type = de->type;
+            memcpy(out->name, de->name, de->name_len);
+            out->name[de->name_len] = '\0';
+            return 1;
         }
     }
+    return 0;
+}
 
-    sb.total_nodes--;
-    sb.used_sectors--;
-    save_superblock();
+uint32_t fs_lookup(uint32_t parent_id, const char* name, uint32_t len) {
+    return lookup_child(parent_id, name, len);
+}
+
+uint32_t fs_find_node_local_id(uint32_t parent_id, char* name) {
+    return lookup_child(parent_id, name, strlen(name));
+}
+
+fs_node_t* fs_find_node(char* path, uint32_t start_id) {
+    if (!path) return 0;
 
-    memset(node, 0, sizeof(fs_node_t));
-    save_node(id);
+    uint32_t current_id = start_id;
 
-    // Invalidate cache entry
-    int idx = cache_find(id);
-    if (idx >= 0) {
-        cache[idx].id = 0;
-        cache[idx].dirty = 0;
+    if (path[0] == '/') {
+        current_id = fs_root_id;
+        path++;
+    }
+
+    // Components are looked up in place; no copy of the path is made
+    while (*path != '\0') {
+        uint32_t len = 0;
+        while (path[len] != '/' && path[len] != '\0') {
+            len++;
+        }
+
+        if (len == 2 && path[0] == '.' && path[1] == '.') {
+            fs_node_t* cur = fs_get_node(current_id);  // Lazy load
+            if (cur) current_id = cur->parent_id;
+        }
+        else if (len == 1 && path[0] == '.') {
+            // Do nothing
+        }
+        else if (len > 0) {
+            uint32_t next_id = lookup_child(current_id, path, len);
+            if (next_id == 0) return 0;
+            current_id = next_id;
+        }
+
+        path += len;
+        if (*path == '/') path++;
+    }
+
+    return fs_get_node(current_id);  // Lazy load final node
+}
+
+int fs_create_node(uint32_t parent_id, const char* name, uint8_t type) {
+    journal_begin();
+    uint32_t id = create_node(parent_id, name, type);
+    journal_end();
+    return id != 0;
+}
+
+/**
+ * @brief Unlinks a node and releases its blocks and ID
+ * @return 1 on success, 0 if missing or a non-empty directory
+ */
+static int delete_node(uint32_t id) {
+    fs_node_t* slot = fs_get_node(id);  // Lazy load
+    if (!slot) return 0;
+
+    if (slot->type == FS_TYPE_DIRECTORY && slot->child_count > 0) {
+        return 0;
+    }
+    uint32_t parent_id = slot->parent_id;
+    char name[FS_MAX_NAME];
+    strcpy(name, slot->name);
+
+    fs_node_t* parent_slot = fs_get_node(parent_id);  // Lazy load parent
+    if (parent_slot) {
+        fs_node_t parent = *parent_slot;
+        dcache_set(parent_id, name, strlen(name), 0);
+        if (dir_remove(&parent, id, name)) {
+            parent.child_count--;
+            save_node(parent_id, &parent);
+        }
     }
 
+    // Release the data blocks, then the ID itself (reused by later creates)
+    fs_node_t* node = fs_get_node(id);
+    if (node) {
+        fs_node_t victim = *node;
+        free_node_blocks(&victim);
+    }
+    pcache_forget(id);
+    bitmap_clear(&inode_map, id);
+
+    sb.total_nodes--;
+    save_superblock();
+
     return 1;
 }
 
+int fs_delete_node(uint32_t id) {
+    journal_begin();
+    int ok = delete_node(id);
+    journal_end();
+    return ok;
+}
+
 void fs_get_disk_stats(uint32_t* total_kb, uint32_t* used_kb, uint32_t* free_kb) {
-    *total_kb = 50 * 1024;
+    *total_kb = (sb.total_sectors * SECTOR_SIZE) / 1024;
     *used_kb = (sb.used_sectors * SECTOR_SIZE) / 1024;
     *free_kb = *total_kb - *used_kb;
 }
 
 // NEW: Get cache statistics
+void fs_get_dcache_stats(uint32_t* hits, uint32_t* misses) {
+    *hits = dcache_hits;
+    *misses = dcache_misses;
+}
+
 void fs_get_cache_stats(uint32_t* cache_size, uint32_t* cached_nodes, uint32_t* dirty_nodes) {
     *cache_size = FS_CACHE_SIZE;
     *cached_nodes = 0;
     *dirty_nodes = 0;
 
     for (int i = 0; i < FS_CACHE_SIZE; i++) {
-        if (cache[i].id != 0) {
+        if (cache[i].lba != 0) {
             (*cached_nodes)++;
             if (cache[i].dirty) {
                 (*dirty_nodes)++;
@@ -539,3 +2405,450 @@ void fs_get_cache_stats(uint32_t* cache_size, uint32_t* cached_nodes, uint32_t*
         }
     }
 }
+
+// The disk as seen by the VFS: the public API above, unchanged
+const vfs_ops_t disk_fs_ops = {
+    .name       = "punixfs",
+    .flags      = VFS_CACHED,
+    .block_size = FS_SECTOR_SIZE,
+    .get_node   = fs_get_node,
+    .lookup     = fs_lookup,
+    .create     = fs_create_node,
+    .remove     = fs_delete_node,
+    .read       = fs_read,
+    .write      = fs_write,
+    .readdir    = fs_readdir,
+    .copy_range = fs_copy_range,
+    .clone      = fs_clone,
+    .get_space  = fs_get_disk_stats,
+    .sync       = fs_sync_node,
+};
+
+// --- Online Consistency Checker ---
+// fsck runs in slices so it can share the machine with the shell: each
+// fs_check_step() does one bounded piece of work. The inode table is read
+// FS_IO_CHUNK sectors at a time straight from disk (after a commit, so the
+// home copies are current), never sector by sector through the cache.
+// Any operation between two slices bumps fs_generation and restarts the
+// pass, so every report describes one consistent state of the filesystem.
+//   Pass 1: scan the inode table, claim blocks, record directory entries
+//   Pass 2: check each inode's link and its path to the root
+//   Pass 3: compare block claims with the bitmap and reference counts,
+//           and the counters with what the scan found
+
+#define FSCK_SCAN        1
+#define FSCK_LINKS       2
+#define FSCK_BLOCKS      3
+#define FSCK_BATCH       4096   // Inodes (or 32 sectors each) per slice
+#define FSCK_MAX_REPORTS 20     // Problems printed per pass
+
+// Per-inode flags
+#define FSCK_VALID       0x01
+#define FSCK_DIR         0x02
+#define FSCK_ENTRY_DIR   0x04   // Named by an entry of directory type
+#define FSCK_REACHABLE   0x08
+#define FSCK_DETACHED    0x10   // No path to the root
+
+typedef struct {
+    uint32_t parent;            // parent_id recorded in the inode
+    uint32_t linked;            // Directory whose entry names it (0 = none)
+} fs_check_node_t;
+
+typedef struct {
+    int       running;
+    int       verbose;          // Print progress (foreground runs)
+    uint32_t  pass;
+    uint32_t  position;         // Next table sector / inode / sector
+    uint32_t  generation;       // fs_generation the pass started from
+    uint32_t  percent;          // Last progress reported
+    uint8_t*  mem;              // Everything below, in one allocation
+    uint32_t  pages;
+    uint8_t*  table;            // FS_IO_CHUNK inode table sectors
+    fs_check_node_t* nodes;
+    uint8_t*  flags;
+    uint8_t*  claims;           // Owners found per sector (saturating)
+    uint32_t  scanned;          // Valid inodes
+    uint32_t  dirs;
+    uint32_t  blocks;           // Sectors claimed
+    uint32_t  errors;
+} fs_check_t;
+
+static fs_check_t fsck;
+
+static void check_report(const char* kind, uint32_t n, const char* what) {
+    fsck.errors++;
+    if (fsck.errors > FSCK_MAX_REPORTS) return;
+
+    char num[12];
+    int_to_str(n, num);
+    console_print_colored("fsck: ", COLOR_LIGHT_RED);
+    console_print(kind);
+    console_print(" ");
+    console_print(num);
+    console_print(": ");
+    console_print(what);
+    console_print("\n");
+}
+
+/**
+ * @brief Marks a sector as owned by an inode
+ */
+static void check_claim(uint32_t id, uint32_t lba) {
+    if (lba < sb.data_start || lba >= sb.total_sectors) {
+        check_report("inode", id, "block pointer out of range");
+        return;
+    }
+    if (fsck.claims[lba] == 0) fsck.blocks++;
+    if (fsck.claims[lba] < 255) fsck.claims[lba]++;
+}
+
+/**
+ * @brief Claims a pointer block and everything below it
+ * @return Sectors claimed, the table included
+ */
+static uint32_t check_table(uint32_t id, uint32_t table_lba, int depth) {
+    uint32_t ptrs[FS_PTRS_PER_BLOCK];
+    check_claim(id, table_lba);
+
+    uint8_t* table = cache_get(table_lba);
+    if (!table) return 1;
+    memcpy(ptrs, table, SECTOR_SIZE);
+
+    uint32_t count = 1;
+    for (uint32_t i = 0; i < FS_PTRS_PER_BLOCK; i++) {
+        if (ptrs[i] == 0) continue;
+        if (depth > 1) {
+            count += check_table(id, ptrs[i], depth - 1);
+        } else {
+            check_claim(id, ptrs[i]);
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Records a directory's entries and checks them against its inode
+ * Entries of an indexed directory must also be found through the index.
+ */
+static void check_directory(fs_node_t* dir) {
+    static uint8_t block[SECTOR_SIZE];
+    uint32_t entries = 0;
+    uint32_t blocks = dir->size / SECTOR_SIZE;
+
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint8_t* data = cache_get(bmap(dir, b, 0));
+        if (!data) {
+            check_report("directory", dir->id, "entry block missing");
+            continue;
+        }
+        memcpy(block, data, SECTOR_SIZE);
+
+        uint32_t off = 0;
+        while (off < SECTOR_SIZE && dirent_valid(block, off)) {
+            fs_disk_dirent_t* de = (fs_disk_dirent_t*)(block + off);
+            off += de->rec_len;
+            if (de->id == 0) continue;
+            entries++;
+
+            if (de->id >= sb.max_nodes || de->name_len == 0 || de->name_len >= FS_MAX_NAME) {
+                check_report("directory", dir->id, "bad entry");
+                continue;
+            }
+            if (fsck.nodes[de->id].linked) {
+                check_report("inode", de->id, "listed in more than one place");
+                continue;
+            }
+            fsck.nodes[de->id].linked = dir->id;
+            if (de->type == FS_TYPE_DIRECTORY) fsck.flags[de->id] |= FSCK_ENTRY_DIR;
+
+            if (dir->flags & FS_FLAG_INDEXED) {
+                uint8_t* leaf = cache_get(dx_leaf_for(dir, de->name, de->name_len));
+                if (!leaf || block_find(leaf, de->name, de->name_len, 0) < 0) {
+                    check_report("inode", de->id, "entry not reachable through the index");
+                }
+            }
+        }
+        if (off != SECTOR_SIZE) {
+            check_report("directory", dir->id, "damaged entry block");
+        }
+    }
+
+    if (entries != dir->child_count) {
+        check_report("directory", dir->id, "child count does not match its entries");
+    }
+}
+
+/**
+ * @brief Claims every block a node points to and checks its block count
+ */
+static void check_pointers(uint32_t id, fs_node_t* node) {
+    uint32_t claimed = 0;
+    for (uint32_t i = 0; i < FS_DIRECT_BLOCKS; i++) {
+        if (node->direct[i]) {
+            check_claim(id, node->direct[i]);
+            claimed++;
+        }
+    }
+    if (node->indirect) claimed += check_table(id, node->indirect, 1);
+    if (node->double_indirect) claimed += check_table(id, node->double_indirect, 2);
+    if (claimed != node->blocks) {
+        check_report("inode", id, "block count does not match its pointers");
+    }
+}
+
+/**
+ * @brief Checks one allocated inode read from the table
+ */
+static void check_inode(uint32_t id, fs_node_t* node) {
+    if (node->id != id || node->type > FS_TYPE_DIRECTORY) {
+        check_report("inode", id, "allocated but not initialised");
+        return;
+    }
+
+    fsck.flags[id] |= FSCK_VALID;
+    fsck.nodes[id].parent = node->parent_id;
+    fsck.scanned++;
+    check_pointers(id, node);
+
+    if (node->type == FS_TYPE_DIRECTORY) {
+        fsck.flags[id] |= FSCK_DIR;
+        fsck.dirs++;
+        check_directory(node);
+    }
+}
+
+/**
+ * @brief Checks that an inode's entry agrees with it and that its chain
+ * of parents reaches the root
+ */
+static void check_links(uint32_t id) {
+    fs_check_node_t* n = &fsck.nodes[id];
+    uint8_t flags = fsck.flags[id];
+
+    if (!(flags & FSCK_VALID)) {
+        if (n->linked) check_report("inode", id, "listed in a directory but free");
+        return;
+    }
+    if (id == FS_ROOT_ID) return;
+
+    if (!n->linked) {
+        check_report("inode", id, "not listed in any directory");
+        return;
+    }
+    if (n->linked != n->parent) {
+        check_report("inode", id, "parent_id disagrees with the directory listing it");
+    }
+    if (!(flags & FSCK_DIR) != !(flags & FSCK_ENTRY_DIR)) {
+        check_report("inode", id, "entry type disagrees with the inode");
+    }
+
+    // Walk up to something known; mark the whole path with the outcome
+    uint32_t x = id;
+    uint32_t steps = 0;
+    while (!(fsck.flags[x] & (FSCK_REACHABLE | FSCK_DETACHED))) {
+        uint32_t up = fsck.nodes[x].linked;
+        if (!up || !(fsck.flags[x] & FSCK_VALID) || ++steps > fsck.scanned) break;
+        x = up;
+    }
+    uint8_t outcome = (fsck.flags[x] & FSCK_REACHABLE) ? FSCK_REACHABLE : FSCK_DETACHED;
+    if (outcome == FSCK_DETACHED) {
+        check_report("inode", id, "no path to the root");
+    }
+    for (x = id; !(fsck.flags[x] & (FSCK_REACHABLE | FSCK_DETACHED)); ) {
+        fsck.flags[x] |= outcome;
+        x = fsck.nodes[x].linked;
+        if (!x) break;
+    }
+}
+
+/**
+ * @brief Compares a data block's owners with the bitmap and its
+ * reference count
+ */
+static void check_block(uint32_t lba) {
+    uint32_t claims = fsck.claims[lba];
+    if (!bitmap_test(&block_map, lba)) {
+        if (claims) check_report("block", lba, "in use but marked free");
+    } else if (claims == 0) {
+        check_report("block", lba, "marked used but owned by nothing");
+    } else if (claims != 1 + block_refs(lba)) {
+        check_report("block", lba, claims > 1 + block_refs(lba) ? "claimed more often than it is shared"
+                                                                 : "reference count too high");
+    }
+}
+
+static void check_counters() {
+    if (sb.total_nodes != fsck.scanned) {
+        check_report("superblock", sb.total_nodes, "node count disagrees with the inode table");
+    }
+    if (sb.used_sectors != sb.data_start + fsck.blocks) {
+        check_report("superblock", sb.used_sectors, "used sector count disagrees with the inodes");
+    }
+}
+
+/**
+ * @brief Releases the checker's memory
+ */
+static void check_finish() {
+    for (uint32_t i = 0; i < fsck.pages; i++) {
+        pmm_free_page(fsck.mem + i * PAGE_SIZE);
+    }
+    fsck.mem = 0;
+    fsck.running = 0;
+
+    char num[12];
+    console_print_colored("fsck: ", fsck.errors ? COLOR_LIGHT_RED : COLOR_GREEN_ON_BLACK);
+    int_to_str(fsck.scanned, num);
+    console_print(num);
+    console_print(" nodes, ");
+    int_to_str(fsck.dirs, num);
+    console_print(num);
+    console_print(" directories, ");
+    int_to_str(fsck.blocks, num);
+    console_print(num);
+    console_print(" blocks: ");
+    if (fsck.errors == 0) {
+        console_print("clean\n");
+    } else {
+        int_to_str(fsck.errors, num);
+        console_print(num);
+        console_print(" problems found\n");
+    }
+}
+
+/**
+ * @brief Clears the per-pass state and starts over from pass 1
+ */
+static void check_restart() {
+    memset(fsck.nodes, 0, sb.max_nodes * sizeof(fs_check_node_t));
+    memset(fsck.flags, 0, sb.max_nodes);
+    memset(fsck.claims, 0, sb.total_sectors);
+    fsck.flags[FS_ROOT_ID] |= FSCK_REACHABLE;
+
+    fsck.pass = FSCK_SCAN;
+    fsck.position = 0;
+    fsck.generation = fs_generation;
+    fsck.percent = 0;
+    fsck.scanned = 0;
+    fsck.dirs = 0;
+    fsck.blocks = 0;
+    fsck.errors = 0;
+}
+
+/**
+ * @brief Progress through the whole check, in percent
+ * The table scan does the disk I/O, so it gets most of the range.
+ */
+static uint32_t check_percent() {
+    if (fsck.pass == FSCK_SCAN) {
+        return fsck.position * 80 / sb.inode_table_sectors;
+    }
+    if (fsck.pass == FSCK_LINKS) {
+        return 80 + fsck.position * 15 / sb.max_nodes;
+    }
+    return 95 + fsck.position * 5 / sb.total_sectors;
+}
+
+int fs_check_start(int verbose) {
+    if (fsck.running) return 1;
+    if (!inode_map.map) return 0;
+
+    uint32_t bytes = FS_IO_CHUNK * SECTOR_SIZE +
+                     sb.max_nodes * sizeof(fs_check_node_t) +
+                     sb.max_nodes + sb.total_sectors;
+    fsck.pages = (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+    fsck.mem = (uint8_t*)pmm_alloc_pages(fsck.pages);
+    if (!fsck.mem) {
+        console_print_colored("fsck: Out of memory.\n", COLOR_LIGHT_RED);
+        return 0;
+    }
+
+    fsck.table = fsck.mem;
+    fsck.nodes = (fs_check_node_t*)(fsck.table + FS_IO_CHUNK * SECTOR_SIZE);
+    fsck.flags = (uint8_t*)(fsck.nodes + sb.max_nodes);
+    fsck.claims = fsck.flags + sb.max_nodes;
+    fsck.verbose = verbose;
+    fsck.running = 1;
+    check_restart();
+    return 1;
+}
+
+int fs_check_step() {
+    if (!fsck.running) return 0;
+
+    // Restart if anything changed since the last slice
+    if (fsck.generation != fs_generation) {
+        check_restart();
+    }
+
+    if (fsck.pass == FSCK_SCAN) {
+        uint32_t count = sb.inode_table_sectors - fsck.position;
+        if (count > FS_IO_CHUNK) count = FS_IO_CHUNK;
+        if (ata_read_sectors(sb.inode_table_start + fsck.position, count, fsck.table) != 0) {
+            check_report("sector", sb.inode_table_start + fsck.position, "inode table unreadable");
+        } else {
+            // The running group holds newer copies than the home sectors
+            for (uint32_t s = 0; s < count; s++) {
+                uint8_t* logged = journal_find(sb.inode_table_start + fsck.position + s);
+                if (logged) memcpy(fsck.table + s * SECTOR_SIZE, logged, SECTOR_SIZE);
+            }
+            fs_node_t* nodes = (fs_node_t*)fsck.table;
+            uint32_t first = fsck.position * FS_INODES_PER_SECTOR;
+            for (uint32_t i = 0; i < count * FS_INODES_PER_SECTOR; i++) {
+                uint32_t id = first + i;
+                if (id == FS_REFS_ID) {
+                    check_pointers(id, &nodes[i]);  // Owns the count sectors
+                } else if (bitmap_test(&inode_map, id)) {
+                    check_inode(id, &nodes[i]);
+                }
+            }
+        }
+        fsck.position += count;
+        if (fsck.position >= sb.inode_table_sectors) {
+            fsck.pass = FSCK_LINKS;
+            fsck.position = 1;
+        }
+    } else if (fsck.pass == FSCK_LINKS) {
+        if (fsck.position == 1 && !(fsck.flags[FS_ROOT_ID] & FSCK_DIR)) {
+            check_report("inode", FS_ROOT_ID, "root is not a directory");
+        }
+        uint32_t end = fsck.position + FSCK_BATCH;
+        if (end > sb.max_nodes) end = sb.max_nodes;
+        for (; fsck.position < end; fsck.position++) {
+            check_links(fsck.position);
+        }
+        if (fsck.position >= sb.max_nodes) {
+            fsck.pass = FSCK_BLOCKS;
+            fsck.position = sb.data_start;
+        }
+    } else {
+        uint32_t end = fsck.position + FSCK_BATCH * 32;
+        if (end > sb.total_sectors) end = sb.total_sectors;
+        for (; fsck.position < end; fsck.position++) {
+            check_block(fsck.position);
+        }
+        if (fsck.position >= sb.total_sectors) {
+            check_counters();
+            check_finish();
+            return 0;
+        }
+    }
+
+    uint32_t percent = check_percent();
+    if (fsck.verbose && percent / 10 > fsck.percent / 10) {
+        char num[12];
+        int_to_str(percent / 10 * 10, num);
+        console_print("fsck: ");
+        console_print(num);
+        console_print("%\n");
+    }
+    fsck.percent = percent;
+    return 1;
+}
+
+int fs_check_status(uint32_t* percent) {
+    if (!fsck.running) return 0;
+    *percent = fsck.percent;
+    return 1;
+}
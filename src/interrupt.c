@@ -20,6 +20,9 @@
 struct idt_entry idt[256];
 struct idt_ptr idtp;
 
+volatile uint32_t interrupt_counts[256];
+static const char* handler_names[256];
+
 // Keyboard buffer (circular)
 #define KEYBOARD_BUFFER_SIZE 256
 static char keyboard_buffer[KEYBOARD_BUFFER_SIZE];
@@ -57,6 +60,7 @@ static const char scancode_to_ascii[] = {
 // Keyboard interrupt handler (IRQ1)
 void keyboard_handler() {
     uint8_t scancode = inb(0x60);
+    interrupt_counts[33]++;
 
     // --- Control Key State Tracking ---
     if (scancode == LCTRL_SCANCODE) {
@@ -188,9 +192,15 @@ void idt_init() {
     // Set keyboard interrupt (IRQ1 = interrupt 33)
     idt_set_gate(33, (uint32_t)keyboard_interrupt_handler, 0x08, 0x8E);
     idt_set_gate(0x80, (uint32_t)syscall_interrupt_wrapper, 0x08, 0x8E);
+    handler_names[33] = "keyboard";
+    handler_names[0x80] = "syscall";
     __asm__ volatile("lidt %0" : : "m"(idtp));
 }
 
+const char* interrupt_get_name(int vector) {
+    return (vector >= 0 && vector < 256) ? handler_names[vector] : 0;
+}
+
 // Initialize PIC
 void pic_init() {
     outb(0x20, 0x11);
@@ -81,6 +81,31 @@ void* pmm_alloc_page() {
     return (void*)addr;
 }
 
+// Allocates a physically contiguous, zeroed run of pages
+void* pmm_alloc_pages(uint32_t count) {
+    if (count == 0) return 0;
+
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < TOTAL_PAGES; i++) {
+        run = pmm_test_page(i) ? 0 : run + 1;
+        if (run == count) {
+            uint32_t first = i + 1 - count;
+            for (uint32_t p = first; p <= i; p++) {
+                pmm_set_page(p);
+            }
+            used_pages += count;
+            free_pages -= count;
+
+            uint32_t* ptr = (uint32_t*)(KERNEL_END + (first * PAGE_SIZE));
+            for (uint32_t w = 0; w < count * (PAGE_SIZE / 4); w++) {
+                ptr[w] = 0;
+            }
+            return (void*)ptr;
+        }
+    }
+    return 0;
+}
+
 void pmm_free_page(void* addr) {
     uint32_t page_addr = (uint32_t)addr;
 
@@ -0,0 +1,258 @@
+/**
+ * src/pagecache.c - Page cache for file data
+ * Whole pages of file contents, keyed by (inode, page number), so that
+ * repeated reads are one memcpy and mmap can hand out the pages directly.
+ * There is no paging: a mapping is the cached page's own address.
+ */
+
+#include "../include/pagecache.h"
+#include "../include/string.h"
+#include "../include/memory.h"
+#include "../include/vfs.h"
+
+typedef struct {
+    uint8_t*  data;          // One page, or 0 for an empty slot
+    uint32_t  node_id;       // 0 = file deleted while mapped
+    uint32_t  index;         // Page number within the file
+    uint32_t  mapped;        // Active mappings; mapped pages never move
+    uint32_t  last_access;   // For LRU eviction
+} pcache_entry_t;
+
+static pcache_entry_t pcache[PCACHE_PAGES];
+static uint32_t pcache_clock = 0;
+static uint32_t pcache_hits = 0;
+static uint32_t pcache_misses = 0;
+
+/**
+ * @brief Finds a cached page
+ * @return The entry, or 0 if the page is not cached
+ */
+static pcache_entry_t* pcache_find(uint32_t node_id, uint32_t index) {
+    for (int i = 0; i < PCACHE_PAGES; i++) {
+        if (pcache[i].data && pcache[i].node_id == node_id && pcache[i].index == index) {
+            pcache[i].last_access = ++pcache_clock;
+            return &pcache[i];
+        }
+    }
+    return 0;
+}
+
+static void pcache_release(pcache_entry_t* e) {
+    pmm_free_page(e->data);
+    e->data = 0;
+    e->node_id = 0;
+    e->mapped = 0;
+}
+
+/**
+ * @brief Finds an empty slot, or evicts the least recently used
+ * unmapped page (its memory is kept for the caller)
+ * @return The slot, or 0 if every page is mapped
+ */
+static pcache_entry_t* pcache_slot() {
+    pcache_entry_t* lru = 0;
+    for (int i = 0; i < PCACHE_PAGES; i++) {
+        if (!pcache[i].data) return &pcache[i];
+        if (pcache[i].mapped) continue;
+        if (!lru || pcache[i].last_access < lru->last_access) {
+            lru = &pcache[i];
+        }
+    }
+    return lru;
+}
+
+/**
+ * @brief Fills a page from the file, zeroing whatever lies past the end
+ * @return 1 on success, 0 on a read error
+ */
+static int pcache_fill(fs_node_t* node, uint32_t index, uint8_t* page) {
+    int got = vfs_read_uncached(node, index * PAGE_SIZE, page, PAGE_SIZE);
+    if (got < 0) return 0;
+    memset(page + got, 0, PAGE_SIZE - got);
+    return 1;
+}
+
+/**
+ * @brief Returns a page of the file, reading it in on a miss
+ * @return The page, or 0 if it could not be cached
+ */
+static uint8_t* pcache_get(fs_node_t* node, uint32_t index) {
+    pcache_entry_t* e = pcache_find(node->id, index);
+    if (e) {
+        pcache_hits++;
+        return e->data;
+    }
+    pcache_misses++;
+
+    e = pcache_slot();
+    if (!e) return 0;
+    if (!e->data) {
+        e->data = (uint8_t*)pmm_alloc_page();
+        if (!e->data) return 0;
+    }
+
+    e->node_id = 0;  // Not valid until filled
+    if (!pcache_fill(node, index, e->data)) {
+        pcache_release(e);
+        return 0;
+    }
+    e->node_id = node->id;
+    e->index = index;
+    e->mapped = 0;
+    e->last_access = ++pcache_clock;
+    return e->data;
+}
+
+int pcache_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count) {
+    if (!node || node->id == 0) return -1;
+
+    fs_node_t n = *node;  // The cache slot behind node may be recycled
+    if (offset >= n.size) return 0;
+    if (count > n.size - offset) count = n.size - offset;
+
+    uint8_t* out = (uint8_t*)buf;
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t in_page = pos % PAGE_SIZE;
+        uint32_t chunk = PAGE_SIZE - in_page;
+        if (chunk > count - done) chunk = count - done;
+
+        uint8_t* page = pcache_get(&n, pos / PAGE_SIZE);
+        if (!page) {
+            // Cache full of mapped pages: read the rest directly
+            int got = vfs_read_uncached(&n, pos, out + done, count - done);
+            if (got < 0) return done > 0 ? (int)done : -1;
+            return done + got;
+        }
+        memcpy(out + done, page + in_page, chunk);
+        done += chunk;
+    }
+    return done;
+}
+
+void* pcache_map(uint32_t node_id, uint32_t offset, uint32_t length) {
+    if (length == 0 || offset % PAGE_SIZE != 0) return 0;
+
+    fs_node_t* slot = vfs_get_node(node_id);
+    if (!slot || slot->type != FS_TYPE_FILE) return 0;
+    fs_node_t node = *slot;
+
+    uint32_t first = offset / PAGE_SIZE;
+    uint32_t count = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (count > PCACHE_PAGES) return 0;
+
+    // Pages already mapped contiguously (by an earlier mmap): share them
+    pcache_entry_t* head = pcache_find(node_id, first);
+    if (head && head->mapped) {
+        for (uint32_t i = 1; i < count; i++) {
+            pcache_entry_t* e = pcache_find(node_id, first + i);
+            if (!e || e->data != head->data + i * PAGE_SIZE) return 0;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            pcache_find(node_id, first + i)->mapped++;
+        }
+        pcache_hits += count;
+        return head->data;
+    }
+
+    // Mapped pages cannot move, so a range overlapping another mapping
+    // cannot be made contiguous
+    for (uint32_t i = 0; i < count; i++) {
+        pcache_entry_t* e = pcache_find(node_id, first + i);
+        if (e && e->mapped) return 0;
+    }
+
+    uint8_t* run = (uint8_t*)pmm_alloc_pages(count);
+    if (!run) return 0;
+
+    // Move or read every page into the run; each entry then owns its page
+    uint32_t placed = 0;
+    for (; placed < count; placed++) {
+        uint8_t* page = run + placed * PAGE_SIZE;
+        pcache_entry_t* e = pcache_find(node_id, first + placed);
+        if (e) {
+            pcache_hits++;
+            memcpy(page, e->data, PAGE_SIZE);
+            pmm_free_page(e->data);
+        } else {
+            pcache_misses++;
+            e = pcache_slot();
+            if (!e || !pcache_fill(&node, first + placed, page)) break;
+            if (e->data) pmm_free_page(e->data);
+            e->node_id = node_id;
+            e->index = first + placed;
+            e->last_access = ++pcache_clock;
+        }
+        e->data = page;
+        e->mapped = 1;
+    }
+
+    if (placed < count) {
+        // Out of slots: keep what was read as ordinary cached pages
+        for (uint32_t i = 0; i < placed; i++) {
+            pcache_find(node_id, first + i)->mapped = 0;
+        }
+        for (uint32_t i = placed; i < count; i++) {
+            pmm_free_page(run + i * PAGE_SIZE);
+        }
+        return 0;
+    }
+    return run;
+}
+
+int pcache_unmap(void* addr, uint32_t length) {
+    uint8_t* start = (uint8_t*)addr;
+    uint8_t* end = start + ((length + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+    int found = 0;
+
+    for (int i = 0; i < PCACHE_PAGES; i++) {
+        pcache_entry_t* e = &pcache[i];
+        if (!e->data || !e->mapped || e->data < start || e->data >= end) continue;
+        found = 1;
+        if (--e->mapped == 0 && e->node_id == 0) {
+            pcache_release(e);  // The file is gone
+        }
+    }
+    return found ? 0 : -1;
+}
+
+void pcache_update(uint32_t node_id, uint32_t offset, const void* buf, uint32_t count) {
+    const uint8_t* in = (const uint8_t*)buf;
+
+    for (int i = 0; i < PCACHE_PAGES; i++) {
+        pcache_entry_t* e = &pcache[i];
+        if (!e->data || e->node_id != node_id) continue;
+
+        uint32_t page_start = e->index * PAGE_SIZE;
+        uint32_t from = offset > page_start ? offset : page_start;
+        uint32_t to = offset + count < page_start + PAGE_SIZE ? offset + count : page_start + PAGE_SIZE;
+        if (from < to) {
+            memcpy(e->data + (from - page_start), in + (from - offset), to - from);
+        }
+    }
+}
+
+void pcache_forget(uint32_t node_id) {
+    for (int i = 0; i < PCACHE_PAGES; i++) {
+        pcache_entry_t* e = &pcache[i];
+        if (!e->data || e->node_id != node_id) continue;
+        if (e->mapped) {
+            e->node_id = 0;  // Freed by the last unmap
+        } else {
+            pcache_release(e);
+        }
+    }
+}
+
+void pcache_get_stats(uint32_t* cached, uint32_t* mapped, uint32_t* hits, uint32_t* misses) {
+    *cached = 0;
+    *mapped = 0;
+    for (int i = 0; i < PCACHE_PAGES; i++) {
+        if (!pcache[i].data) continue;
+        (*cached)++;
+        if (pcache[i].mapped) (*mapped)++;
+    }
+    *hits = pcache_hits;
+    *misses = pcache_misses;
+}
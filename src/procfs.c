@@ -0,0 +1,275 @@
+/**
+ * src/procfs.c - Kernel statistics filesystem
+ * Every file is a generator over counters the rest of the kernel keeps
+ * anyway. Nothing is stored: a read renders the current values as text,
+ * so monitoring is a plain file read (or a cat over the serial console).
+ */
+
+#include "../include/procfs.h"
+#include "../include/string.h"
+#include "../include/memory.h"
+#include "../include/console.h"
+#include "../include/pagecache.h"
+#include "../include/tmpfs.h"
+#include "../include/ata.h"
+#include "../include/interrupt.h"
+#include "../include/syscall.h"
+
+#define PROCFS_LABEL_WIDTH  16
+
+typedef struct {
+    const char* name;
+    void (*generate)();
+} procfs_file_t;
+
+static void gen_meminfo();
+static void gen_fscache();
+static void gen_diskstats();
+static void gen_interrupts();
+static void gen_syscalls();
+
+// Index i + 1 is the low part of the file's ID (0 is the root)
+static const procfs_file_t files[] = {
+    { "meminfo",    gen_meminfo },
+    { "fscache",    gen_fscache },
+    { "diskstats",  gen_diskstats },
+    { "interrupts", gen_interrupts },
+    { "syscalls",   gen_syscalls },
+};
+#define PROCFS_FILES (sizeof(files) / sizeof(files[0]))
+
+static fs_node_t nodes[PROCFS_FILES + 1];
+static char* text = 0;              // One page; generated files must fit
+static uint32_t text_len = 0;
+static uint32_t snapshot_id = 0;    // File whose text is in the buffer
+
+// --- Text output ---
+
+static void put(const char* s) {
+    while (*s && text_len < PAGE_SIZE) {
+        text[text_len++] = *s++;
+    }
+}
+
+/**
+ * @brief Appends an unsigned number (int_to_str stops at 2^31)
+ */
+static void put_num(uint32_t value) {
+    char digits[11];
+    int i = 10;
+    digits[i] = '\0';
+    do {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    put(&digits[i]);
+}
+
+static void put_pad(uint32_t from, uint32_t width) {
+    while (text_len - from < width) put(" ");
+}
+
+/**
+ * @brief Appends "Label:   value unit\n" with the values in one column
+ */
+static void put_field(const char* label, uint32_t value, const char* unit) {
+    uint32_t start = text_len;
+    put(label);
+    put(":");
+    put_pad(start, PROCFS_LABEL_WIDTH);
+    put_num(value);
+    if (unit) {
+        put(" ");
+        put(unit);
+    }
+    put("\n");
+}
+
+// --- Generators ---
+
+static void gen_meminfo() {
+    uint32_t total, used, free;
+    pmm_get_stats(&total, &used, &free);
+    put_field("MemTotal", total * (PAGE_SIZE / 1024), "kB");
+    put_field("MemUsed", used * (PAGE_SIZE / 1024), "kB");
+    put_field("MemFree", free * (PAGE_SIZE / 1024), "kB");
+
+    uint32_t pages, mapped, hits, misses;
+    pcache_get_stats(&pages, &mapped, &hits, &misses);
+    put_field("PageCache", pages * (PAGE_SIZE / 1024), "kB");
+    put_field("Mapped", mapped * (PAGE_SIZE / 1024), "kB");
+
+    uint32_t tmp_nodes, tmp_max_nodes, tmp_used_kb, tmp_limit_kb;
+    tmpfs_get_stats(&tmp_nodes, &tmp_max_nodes, &tmp_used_kb, &tmp_limit_kb);
+    put_field("Tmpfs", tmp_used_kb, "kB");
+    put_field("TmpfsLimit", tmp_limit_kb, "kB");
+}
+
+static void gen_fscache() {
+    uint32_t cache_size, cached, dirty;
+    fs_get_cache_stats(&cache_size, &cached, &dirty);
+    put_field("SectorCache", cache_size, "sectors");
+    put_field("SectorCached", cached, "sectors");
+    put_field("SectorDirty", dirty, "sectors");
+
+    uint32_t hits, misses;
+    fs_get_dcache_stats(&hits, &misses);
+    put_field("LookupHits", hits, 0);
+    put_field("LookupMisses", misses, 0);
+
+    uint32_t pages, mapped;
+    pcache_get_stats(&pages, &mapped, &hits, &misses);
+    put_field("PageCache", pages, "pages");
+    put_field("PageMapped", mapped, "pages");
+    put_field("PageHits", hits, 0);
+    put_field("PageMisses", misses, 0);
+}
+
+static void gen_diskstats() {
+    ata_stats_t s;
+    ata_get_stats(&s);
+    put_field("Reads", s.reads, 0);
+    put_field("SectorsRead", s.sectors_read, 0);
+    put_field("Writes", s.writes, 0);
+    put_field("SectorsWritten", s.sectors_written, 0);
+    put_field("Flushes", s.flushes, 0);
+    put_field("Errors", s.errors, 0);
+
+    uint32_t total_kb, used_kb, free_kb;
+    fs_get_disk_stats(&total_kb, &used_kb, &free_kb);
+    put_field("DiskTotal", total_kb, "kB");
+    put_field("DiskUsed", used_kb, "kB");
+    put_field("DiskFree", free_kb, "kB");
+}
+
+static void gen_interrupts() {
+    // "vector:      count  handler", for every vector with a handler
+    for (int v = 0; v < 256; v++) {
+        const char* name = interrupt_get_name(v);
+        if (!name) continue;
+        uint32_t start = text_len;
+        put_num(v);
+        put(":");
+        put_pad(start, 5);
+        uint32_t count_start = text_len;
+        put_num(interrupt_counts[v]);
+        put_pad(count_start, 12);
+        put(name);
+        put("\n");
+    }
+}
+
+static void gen_syscalls() {
+    for (uint32_t n = 0; n < SYS_COUNT; n++) {
+        const char* name = syscall_get_name(n);
+        if (name) put_field(name, syscall_get_count(n), 0);
+    }
+}
+
+// --- Filesystem operations ---
+
+static fs_node_t* procfs_node(uint32_t id) {
+    if (!text || VFS_TAG(id) != PROCFS_TAG) return 0;
+    uint32_t index = id & ~PROCFS_ID_BASE;
+    return index <= PROCFS_FILES ? &nodes[index] : 0;
+}
+
+int procfs_init(const char* name) {
+    if (!text) {
+        text = (char*)pmm_alloc_page();
+        if (!text) {
+            console_print_colored("procfs: Out of memory.\n", COLOR_LIGHT_RED);
+            return 0;
+        }
+    }
+    snapshot_id = 0;
+
+    memset(nodes, 0, sizeof(nodes));
+    nodes[0].id = PROCFS_ROOT_ID;
+    nodes[0].parent_id = PROCFS_ROOT_ID;  // The VFS takes ".." out of the mount
+    nodes[0].type = FS_TYPE_DIRECTORY;
+    nodes[0].child_count = PROCFS_FILES;
+    strncpy(nodes[0].name, name, FS_MAX_NAME - 1);
+
+    for (uint32_t i = 0; i < PROCFS_FILES; i++) {
+        fs_node_t* node = &nodes[i + 1];
+        node->id = PROCFS_ID_BASE | (i + 1);
+        node->parent_id = PROCFS_ROOT_ID;
+        node->type = FS_TYPE_FILE;
+        strcpy(node->name, files[i].name);
+    }
+    return 1;
+}
+
+fs_node_t* procfs_get_node(uint32_t id) {
+    return procfs_node(id);
+}
+
+uint32_t procfs_lookup(uint32_t dir_id, const char* name, uint32_t len) {
+    if (dir_id != PROCFS_ROOT_ID || !text) return 0;
+    for (uint32_t i = 0; i < PROCFS_FILES; i++) {
+        if ((uint32_t)strlen(files[i].name) == len && memcmp(files[i].name, name, len) == 0) {
+            return nodes[i + 1].id;
+        }
+    }
+    return 0;
+}
+
+static int procfs_create(uint32_t parent_id, const char* name, uint8_t type) {
+    (void)parent_id; (void)name; (void)type;
+    return 0;  // The file set is fixed
+}
+
+static int procfs_remove(uint32_t id) {
+    (void)id;
+    return 0;
+}
+
+int procfs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count) {
+    fs_node_t* n = node ? procfs_node(node->id) : 0;
+    if (!n || n->type != FS_TYPE_FILE) return -1;
+
+    // Regenerate at the start of a read, or if another file was read since
+    if (offset == 0 || snapshot_id != n->id) {
+        text_len = 0;
+        files[(n->id & ~PROCFS_ID_BASE) - 1].generate();
+        snapshot_id = n->id;
+    }
+
+    if (offset >= text_len) return 0;
+    if (count > text_len - offset) count = text_len - offset;
+    memcpy(buf, text + offset, count);
+    return count;
+}
+
+static int procfs_write(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count) {
+    (void)node; (void)offset; (void)buf; (void)count;
+    return -1;  // Read-only
+}
+
+int procfs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out) {
+    if (dir_id != PROCFS_ROOT_ID || !text || *cursor >= PROCFS_FILES) return 0;
+
+    fs_node_t* node = &nodes[++(*cursor)];
+    out->id = node->id;
+    out->type = node->type;
+    strcpy(out->name, node->name);
+    return 1;
+}
+
+const vfs_ops_t procfs_ops = {
+    .name       = "procfs",
+    .flags      = 0,
+    .block_size = 0,
+    .get_node   = procfs_get_node,
+    .lookup     = procfs_lookup,
+    .create     = procfs_create,
+    .remove     = procfs_remove,
+    .read       = procfs_read,
+    .write      = procfs_write,
+    .readdir    = procfs_readdir,
+    .copy_range = 0,
+    .clone      = 0,
+    .get_space  = 0,
+    .sync       = 0,
+};
@@ -10,6 +10,12 @@
 #include "../include/string.h"
 #include "../include/text.h"
 #include "../include/auth.h"
+#include "../include/pagecache.h"
+#include "../include/tmpfs.h"
+#include "../include/vfs.h"
+
+#define LS_BATCH        16      // Entries per getdents call
+#define LS_BATCH_PLUS   8       // Entries per getdents_plus call (ls -l)
 
 // --- Shell Globals ---
 int ROOT_ACCESS_GRANTED = 0;
@@ -35,6 +41,10 @@ void history_delete(int index);
 void read_line_with_display(char* buffer, int max_len) {
     int i = 0;
     while (i < max_len - 1) {
+        // Background work (fsck) only gets the time spent waiting for keys
+        while (!keyboard_has_data() && fs_check_step()) {
+            __asm__ volatile("sti; nop; cli");  // Let a pending key in
+        }
         char c = keyboard_read();
         if (c == '\n') {
             buffer[i] = '\0';
@@ -98,33 +108,89 @@ void cmd_pwd() {
     }
 }
 
-void cmd_ls() {
-    struct dirent entries[16];
+/**
+ * @brief Prints one ls -l line: type, size, allocated KB and name
+ */
+static void ls_long_entry(struct dirent_plus* e) {
+    char num[12];
+    struct stat* st = &e->d_stat;
+    if (st->st_type == FS_TYPE_DIRECTORY) console_print("d ");
+    else if (st->st_type == FS_TYPE_CHAR_DEVICE) console_print("c ");
+    else if (st->st_type == FS_TYPE_BLOCK_DEVICE) console_print("b ");
+    else console_print("- ");
+
+    int_to_str(st->st_size, num);
+    for (int pad = strlen(num); pad < 9; pad++) console_print(" ");
+    console_print(num);
+    int_to_str((st->st_blocks + 1) / 2, num);
+    for (int pad = strlen(num); pad < 6; pad++) console_print(" ");
+    console_print(num);
+    console_print(" KB  ");
 
-    // Get directory entries via syscall
-    int count = sys_getdents(".", entries, 16);
+    if (st->st_type == FS_TYPE_DIRECTORY) {
+        console_print_colored(e->d_name, COLOR_YELLOW_ON_BLACK);
+        console_print_colored("/", COLOR_YELLOW_ON_BLACK);
+    } else {
+        console_print_colored(e->d_name, COLOR_WHITE_ON_BLACK);
+    }
+    console_print("\n");
+}
 
-    if (count < 0) {
-        console_print_colored("Error: Cannot read directory\n", COLOR_LIGHT_RED);
-        return;
+static void ls_entry(struct dirent* e) {
+    if (e->d_type == FS_TYPE_DIRECTORY) {
+        console_print_colored(e->d_name, COLOR_YELLOW_ON_BLACK);
+        console_print_colored("/", COLOR_YELLOW_ON_BLACK);
+    } else {
+        console_print_colored(e->d_name, COLOR_WHITE_ON_BLACK);
+        if (e->d_type == FS_TYPE_CHAR_DEVICE) console_print(" (char device)");
+        else if (e->d_type == FS_TYPE_BLOCK_DEVICE) console_print(" (block device)");
+        else console_print(" (file)");
     }
+    console_print("\n");
+}
 
-    if (count == 0) {
-        console_print_colored("Directory is empty.\n", COLOR_YELLOW_ON_BLACK);
+void cmd_ls(char* args) {
+    int long_format = args && strcmp(args, "-l") == 0;
+
+    // The directory fd keeps our place, so any size streams in batches
+    int fd = sys_open(".", O_RDONLY);
+    if (fd < 0) {
+        console_print_colored("Error: Cannot read directory\n", COLOR_LIGHT_RED);
         return;
     }
 
-    console_print_colored("Contents:\n", COLOR_YELLOW_ON_BLACK);
+    union {
+        struct dirent plain[LS_BATCH];
+        struct dirent_plus plus[LS_BATCH_PLUS];
+    } batch;
+    int total = 0;
+    int count;
 
-    for (int i = 0; i < count; i++) {
-        if (entries[i].d_type == FS_TYPE_DIRECTORY) {
-            console_print_colored(entries[i].d_name, COLOR_YELLOW_ON_BLACK);
-            console_print_colored("/", COLOR_YELLOW_ON_BLACK);
+    while (1) {
+        int max = long_format ? LS_BATCH_PLUS : LS_BATCH;
+        if (long_format) {
+            count = sys_getdents_plus_fd(fd, batch.plus, max);
         } else {
-            console_print_colored(entries[i].d_name, COLOR_WHITE_ON_BLACK);
-            console_print(" (file)");
+            count = sys_getdents_fd(fd, batch.plain, max);
         }
-        console_print("\n");
+        if (count <= 0) break;
+        if (count > max) count = max;  // Never read past the batch
+
+        if (total == 0 && !long_format) {
+            console_print_colored("Contents:\n", COLOR_YELLOW_ON_BLACK);
+        }
+        for (int i = 0; i < count; i++) {
+            if (long_format) ls_long_entry(&batch.plus[i]);
+            else ls_entry(&batch.plain[i]);
+        }
+        total += count;
+    }
+    sys_close(fd);
+
+    if (count < 0) {
+        console_print_colored("Error: Cannot read directory\n", COLOR_LIGHT_RED);
+    } else if (total == 0) {
+        console_print_colored("Directory is empty.\n", COLOR_YELLOW_ON_BLACK);
     }
 }
 
@@ -280,23 +346,20 @@ void cmd_echo(char* args) {
         return;
     }
 
-    // Try to open file
-    int fd = sys_open(filename, O_WRONLY);
-
-    if (fd < 0) {
-        // File doesn't exist, create it
-        sys_create_file(filename);
-        fd = sys_open(filename, O_WRONLY);
-    }
+    // Open the file, creating it if it doesn't exist
+    int fd = sys_open(filename, O_WRONLY | O_CREAT);
 
     if (fd < 0) {
         console_print_colored("echo: Cannot write to file\n", COLOR_LIGHT_RED);
         return;
     }
 
-    // Write text
-    sys_write(fd, text, strlen(text));
-    sys_write(fd, "\n", 1);
+    // Write text and newline in one call
+    struct iovec line[2] = {
+        { text, strlen(text) },
+        { "\n", 1 },
+    };
+    sys_writev(fd, line, 2);
 
     sys_close(fd);
 
@@ -339,37 +402,76 @@ void cmd_cp(char* args) {
         return;
     }
 
-    // Read source
-    char buffer[401];
-    int bytes_read = sys_read(fd_src, buffer, 400);
-    sys_close(fd_src);
-
-    if (bytes_read < 0) {
-        console_print_colored("cp: Error reading source file\n", COLOR_LIGHT_RED);
-        return;
-    }
-
     // Create destination
     sys_create_file(dest);
 
     // Open destination
     int fd_dest = sys_open(dest, O_WRONLY);
     if (fd_dest < 0) {
+        sys_close(fd_src);
         console_print_colored("cp: Cannot create destination file\n", COLOR_LIGHT_RED);
         return;
     }
 
-    // Write to destination
-    int bytes_written = sys_write(fd_dest, buffer, bytes_read);
+    // The kernel copies block to block; nothing passes through here.
+    // The source size bounds the loop whatever the calls return.
+    struct stat st;
+    uint32_t size = sys_stat(source, &st) == 0 ? st.st_size : 0;
+    uint32_t total = 0;
+    int copied = 0;
+    while (total < size) {
+        copied = sys_copy_file_range(fd_src, fd_dest, size - total);
+        if (copied <= 0) break;
+        total += copied;
+    }
+    sys_close(fd_src);
     sys_close(fd_dest);
 
+    if (copied < 0) {
+        console_print_colored("cp: Error copying file\n", COLOR_LIGHT_RED);
+        return;
+    }
+
     console_print_colored("Copied ", COLOR_GREEN_ON_BLACK);
     char num[12];
-    int_to_str(bytes_written, num);
+    int_to_str(total, num);
     console_print(num);
     console_print(" bytes\n");
 }
 
+// --- clone command (copy-on-write snapshot of a file or tree) ---
+void cmd_clone(char* args) {
+    char source[64];
+    char dest[64];
+    int i = 0, j = 0;
+
+    while (args[i] && args[i] != ' ') {
+        source[j++] = args[i++];
+    }
+    source[j] = '\0';
+    if (args[i] == ' ') i++;
+    j = 0;
+    while (args[i]) {
+        dest[j++] = args[i++];
+    }
+    dest[j] = '\0';
+
+    if (strlen(source) == 0 || strlen(dest) == 0) {
+        console_print_colored("Usage: clone <source> <name>\n", COLOR_YELLOW_ON_BLACK);
+        return;
+    }
+
+    if (sys_reflink(source, dest) == 0) {
+        console_print_colored("Cloned ", COLOR_GREEN_ON_BLACK);
+        console_print(source);
+        console_print(" to ");
+        console_print(dest);
+        console_print("\n");
+    } else {
+        console_print_colored("clone: Failed to clone\n", COLOR_LIGHT_RED);
+    }
+}
+
 // --- Standard Shell Commands ---
 
 void cmd_add(char* args) {
@@ -414,15 +516,14 @@ void cmd_add(char* args) {
         console_print_colored("Saving result to disk...\n", COLOR_YELLOW_ON_BLACK);
 
         // Create/open results.txt via syscall
-        int fd = sys_open("results.txt", O_WRONLY);
-        if (fd < 0) {
-            sys_create_file("results.txt");
-            fd = sys_open("results.txt", O_WRONLY);
-        }
+        int fd = sys_open("results.txt", O_WRONLY | O_CREAT);
 
         if (fd >= 0) {
-            sys_write(fd, last_result, strlen(last_result));
-            sys_write(fd, "\n", 1);
+            struct iovec line[2] = {
+                { last_result, strlen(last_result) },
+                { "\n", 1 },
+            };
+            sys_writev(fd, line, 2);
             sys_close(fd);
             console_print_colored("Result saved to results.txt\n", COLOR_GREEN_ON_BLACK);
         } else {
@@ -482,12 +583,34 @@ void cmd_mem() {
     uint32_t cache_size, cached_nodes, dirty_nodes;
     fs_get_cache_stats(&cache_size, &cached_nodes, &dirty_nodes);
 
-    console_print("Cache Size:    "); int_to_str(cache_size, num); console_print(num); console_print(" slots\n");
-    console_print("Cached Nodes:  "); int_to_str(cached_nodes, num); console_print(num); console_print("\n");
-    console_print("Dirty Nodes:   "); int_to_str(dirty_nodes, num); console_print(num); console_print(" (pending write)\n");
+    console_print("Cache Size:    "); int_to_str(cache_size, num); console_print(num); console_print(" sectors\n");
+    console_print("Cached Blocks: "); int_to_str(cached_nodes, num); console_print(num); console_print("\n");
+    console_print("Dirty Blocks:  "); int_to_str(dirty_nodes, num); console_print(num); console_print(" (pending write)\n");
 
     uint32_t cache_usage = (cached_nodes * 100) / cache_size;
     console_print("Cache Usage:   "); int_to_str(cache_usage, num); console_print(num); console_print("%\n");
+
+    uint32_t dcache_hits, dcache_misses;
+    fs_get_dcache_stats(&dcache_hits, &dcache_misses);
+    console_print("Lookup Hits:   "); int_to_str(dcache_hits, num); console_print(num); console_print("\n");
+    console_print("Lookup Misses: "); int_to_str(dcache_misses, num); console_print(num); console_print("\n");
+
+    uint32_t pages, mapped, page_hits, page_misses;
+    pcache_get_stats(&pages, &mapped, &page_hits, &page_misses);
+    console_print("Page Cache:    "); int_to_str(pages, num); console_print(num);
+    console_print(" pages ("); int_to_str(mapped, num); console_print(num); console_print(" mapped)\n");
+    console_print("Page Hits:     "); int_to_str(page_hits, num); console_print(num); console_print("\n");
+    console_print("Page Misses:   "); int_to_str(page_misses, num); console_print(num); console_print("\n");
+
+    console_print("\n");
+    console_print_colored("=== tmpfs (/tmp) ===\n", COLOR_GREEN_ON_BLACK);
+
+    uint32_t tmp_nodes, tmp_max_nodes, tmp_used_kb, tmp_limit_kb;
+    tmpfs_get_stats(&tmp_nodes, &tmp_max_nodes, &tmp_used_kb, &tmp_limit_kb);
+    console_print("Used:  "); int_to_str(tmp_used_kb, num); console_print(num);
+    console_print(" of "); int_to_str(tmp_limit_kb, num); console_print(num); console_print(" KB\n");
+    console_print("Nodes: "); int_to_str(tmp_nodes, num); console_print(num);
+    console_print(" of "); int_to_str(tmp_max_nodes, num); console_print(num); console_print("\n");
 }
 
 void cmd_sysinfo() {
@@ -512,9 +635,11 @@ void cmd_sysinfo() {
     // Disk layout info
     console_print_colored("Disk Layout:\n", COLOR_YELLOW_ON_BLACK);
     console_print("  Sector 0:       Bootloader (512 bytes)\n");
-    console_print("  Sectors 1-60:   Kernel binary (~30 KB)\n");
     console_print("  Sector 61:      Filesystem superblock\n");
-    console_print("  Sectors 62+:    Filesystem data\n");
+    console_print("  Sectors 190+:   Metadata journal\n");
+    console_print("  Sectors 256+:   Kernel binary (up to 128 KB)\n");
+    console_print("  Sectors 512+:   Bitmaps + inode table\n");
+    console_print("  Then:           File data blocks\n");
     console_print("\n");
 
     console_print_colored("Current User: ", COLOR_YELLOW_ON_BLACK);
@@ -593,12 +718,62 @@ void cmd_sudo(char* args) {
     }
 }
 
+/**
+ * @brief Checks the filesystem; "fsck &" runs it while the shell is idle
+ */
+void cmd_fsck(char* args) {
+    uint32_t percent;
+    if (fs_check_status(&percent)) {
+        char num[12];
+        int_to_str(percent, num);
+        console_print("fsck: ");
+        console_print(num);
+        console_print("% done (running in the background)\n");
+        return;
+    }
+
+    int background = strcmp(args, "&") == 0;
+    if (!fs_check_start(!background)) return;
+
+    if (background) {
+        console_print_colored("fsck: started in the background\n", COLOR_GREEN_ON_BLACK);
+        return;
+    }
+    while (fs_check_step()) {
+    }
+}
+
+/**
+ * @brief Lists the mount table
+ */
+void cmd_mount() {
+    char num[12];
+    const vfs_mount_t* m;
+    for (uint32_t i = 0; (m = vfs_get_mount(i)) != 0; i++) {
+        console_print(m->ops->name);
+        console_print(" on ");
+        console_print(m->path);
+        if (m->ops->get_space) {
+            uint32_t total_kb, used_kb, free_kb;
+            m->ops->get_space(&total_kb, &used_kb, &free_kb);
+            console_print(" (");
+            int_to_str(used_kb, num); console_print(num);
+            console_print(" of ");
+            int_to_str(total_kb, num); console_print(num);
+            console_print(" KB used)");
+        }
+        console_print("\n");
+    }
+}
+
 void cmd_shutdown() {
     if (!ROOT_ACCESS_GRANTED) {
         console_print_colored("shutdown: permission denied (try 'sudo shutdown')\n", COLOR_LIGHT_RED);
         return;
     }
 
+    syscall_flush_all();
+    fs_commit();
     console_clear_screen();
     console_print_colored("SHUTTING DOWN SYSTEM...\n", COLOR_LIGHT_RED);
     console_print_colored("Goodbye!\n", COLOR_GREEN_ON_BLACK);
@@ -632,7 +807,7 @@ void cmd_help() {
     console_print("\n");
 
     console_print_colored("Filesystem Commands:\n", COLOR_YELLOW_ON_BLACK);
-    console_print("  ls            - List directory contents\n");
+    console_print("  ls [-l]       - List directory contents (-l: sizes)\n");
     console_print("  cd [dir]      - Change directory\n");
     console_print("  pwd           - Show current path\n");
     console_print("  mkdir [name]  - Create directory\n");
@@ -641,8 +816,11 @@ void cmd_help() {
     console_print("  touch [file]  - Create empty file\n");
     console_print("  echo [text] [file] - Write text to file\n");
     console_print("  cp [src] [dst] - Copy file\n");
+    console_print("  clone [src] [name] - Snapshot file or tree (shares data)\n");
     console_print("  text [file]   - Open text editor\n");
     console_print("  sync          - Flush cache to disk\n");
+    console_print("  fsck [&]      - Check filesystem (& = in background)\n");
+    console_print("  mount         - List mounted filesystems\n");
     console_print("\n");
 
     console_print_colored("System Commands:\n", COLOR_YELLOW_ON_BLACK);
@@ -712,7 +890,7 @@ void shell_run() {
         args[j] = '\0';
 
         // Command routing using syscalls
-        if (strcmp(cmd, "ls") == 0) cmd_ls();
+        if (strcmp(cmd, "ls") == 0) cmd_ls(args);
         else if (strcmp(cmd, "pwd") == 0) cmd_pwd();
         else if (strcmp(cmd, "cd") == 0) cmd_cd(args);
         else if (strcmp(cmd, "mkdir") == 0) cmd_mkdir(args);
@@ -721,6 +899,7 @@ void shell_run() {
         else if (strcmp(cmd, "touch") == 0) cmd_touch(args);
         else if (strcmp(cmd, "echo") == 0) cmd_echo(args);
         else if (strcmp(cmd, "cp") == 0) cmd_cp(args);
+        else if (strcmp(cmd, "clone") == 0) cmd_clone(args);
         else if (strcmp(cmd, "help") == 0) cmd_help();
         else if (strcmp(cmd, "clear") == 0) cmd_clear();
         else if (strcmp(cmd, "mem") == 0) cmd_mem();
@@ -732,12 +911,19 @@ void shell_run() {
         else if (strcmp(cmd, "text") == 0) text_editor(args);
         else if (strcmp(cmd, "sudo") == 0) cmd_sudo(args);
         else if (strcmp(cmd, "shutdown") == 0) cmd_shutdown();
-        else if (strcmp(cmd, "sync") == 0) fs_sync();
+        else if (strcmp(cmd, "sync") == 0) { syscall_flush_all(); fs_sync(); }
+        else if (strcmp(cmd, "fsck") == 0) cmd_fsck(args);
+        else if (strcmp(cmd, "mount") == 0) cmd_mount();
         else if (strcmp(cmd, "chuser") == 0) cmd_chuser();
         else if (strcmp(cmd, "chpasswd") == 0) cmd_chpasswd();
         else {
             console_print(cmd);
             console_print_colored(": command not found\n", COLOR_YELLOW_ON_BLACK);
         }
+
+        // Buffered writes reach the filesystem; the journal commits them
+        // in groups, or on sync/fsync/shutdown
+        syscall_io_release();
+        syscall_flush_all();
     }
 }
@@ -30,6 +30,22 @@ void* memcpy(void* dest, const void* src, size_t n) {
 	return dest;
 }
 
+/**
+ * Compares two memory blocks byte by byte.
+ * @return Zero if equal, otherwise the difference of the first mismatching bytes.
+ */
+int memcmp(const void* s1, const void* s2, size_t n) {
+	const unsigned char* a = (const unsigned char*)s1;
+	const unsigned char* b = (const unsigned char*)s2;
+
+	for (size_t i = 0; i < n; i++) {
+		if (a[i] != b[i]) {
+			return a[i] - b[i];
+		}
+	}
+	return 0;
+}
+
 void strcat(char* dest, const char* source){
 	int i = 0, j = 0;
 	while(dest[i] != '\0'){
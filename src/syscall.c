@@ -10,22 +10,77 @@
 #include "../include/fs.h"
 #include "../include/string.h"
 #include "../include/memory.h"
+#include "../include/pagecache.h"
+#include "../include/vfs.h"
 
 
 // File descriptor table (simplified - single process for now)
 #define MAX_FDS 16
+#define FD_WBUF_SIZE PAGE_SIZE  // Write buffer of an fd on a disk file
+#define IOV_STAGE_PAGES 16      // writev gathers this much per filesystem write
+#define AT_PATH_MAX 128         // Longest directory part of a created path
 typedef struct {
     uint32_t node_id;        // Filesystem node ID
     uint32_t offset;         // Current read/write position
     uint8_t  flags;          // Open flags
     uint8_t  in_use;         // 1 if FD is allocated
+    uint8_t* wbuf;           // Write buffer (kept by the slot once allocated)
+    uint32_t wbuf_len;       // Pending bytes; they end at offset
 } file_descriptor_t;
 
 static file_descriptor_t fd_table[MAX_FDS];
+static uint8_t* iov_stage = 0;
+
+// I/O ring registered by sys_io_setup. Entries from sq_head up to
+// ring_submitted are submitted but not yet run.
+static struct io_uring* ring = 0;
+static uint32_t ring_submitted = 0;
 
 // Current working directory (global for now)
 static uint32_t current_cwd = 0;
 
+// Calls per syscall number since boot
+static uint32_t syscall_counts[SYS_COUNT];
+
+static const char* const syscall_names[SYS_COUNT] = {
+    [SYS_READ]            = "read",
+    [SYS_WRITE]           = "write",
+    [SYS_OPEN]            = "open",
+    [SYS_CLOSE]           = "close",
+    [SYS_GETDENTS]        = "getdents",
+    [SYS_CHDIR]           = "chdir",
+    [SYS_GETCWD]          = "getcwd",
+    [SYS_MKDIR]           = "mkdir",
+    [SYS_RMDIR]           = "rmdir",
+    [SYS_UNLINK]          = "unlink",
+    [SYS_STAT]            = "stat",
+    [SYS_EXIT]            = "exit",
+    [SYS_GETPID]          = "getpid",
+    [SYS_MALLOC]          = "malloc",
+    [SYS_FREE]            = "free",
+    [SYS_PRINT]           = "print",
+    [SYS_CREATE_FILE]     = "create_file",
+    [SYS_MMAP]            = "mmap",
+    [SYS_MUNMAP]          = "munmap",
+    [SYS_COPY_FILE_RANGE] = "copy_file_range",
+    [SYS_REFLINK]         = "reflink",
+    [SYS_LSEEK]           = "lseek",
+    [SYS_PREAD]           = "pread",
+    [SYS_PWRITE]          = "pwrite",
+    [SYS_READV]           = "readv",
+    [SYS_WRITEV]          = "writev",
+    [SYS_GETDENTS_PLUS]   = "getdents_plus",
+    [SYS_GETDENTS_FD]     = "getdents_fd",
+    [SYS_GETDENTS_PLUS_FD] = "getdents_plus_fd",
+    [SYS_OPENAT]          = "openat",
+    [SYS_MKDIRAT]         = "mkdirat",
+    [SYS_FSTATAT]         = "fstatat",
+    [SYS_FSYNC]           = "fsync",
+    [SYS_FDATASYNC]       = "fdatasync",
+    [SYS_IO_SETUP]        = "io_setup",
+    [SYS_IO_ENTER]        = "io_enter",
+};
+
 /**
  * @brief Initialize file descriptor table
  */
@@ -33,14 +88,15 @@ void syscall_init() {
     // Clear FD table
     for (int i = 0; i < MAX_FDS; i++) {
         fd_table[i].in_use = 0;
+        fd_table[i].wbuf_len = 0;
     }
 
     // Set initial working directory to /a
-    fs_node_t* dir_a = fs_find_node("a", fs_root_id);
+    fs_node_t* dir_a = vfs_find_node("/a", vfs_root_id);
     if (dir_a) {
         current_cwd = dir_a->id;
     } else {
-        current_cwd = fs_root_id;
+        current_cwd = vfs_root_id;
     }
 }
 
@@ -54,6 +110,7 @@ static int allocate_fd(uint32_t node_id, uint8_t flags) {
             fd_table[i].offset = 0;
             fd_table[i].flags = flags;
             fd_table[i].in_use = 1;
+            fd_table[i].wbuf_len = 0;
             return i;
         }
     }
@@ -61,12 +118,421 @@ static int allocate_fd(uint32_t node_id, uint8_t flags) {
 }
 
 /**
- * @brief Free a file descriptor
+ * @brief Writes out an fd's buffered data
+ * @return 0 on success, -1 if the data could not all be written
+ */
+static int flush_fd(file_descriptor_t* f) {
+    if (f->wbuf_len == 0) return 0;
+
+    uint32_t len = f->wbuf_len;
+    f->wbuf_len = 0;
+    fs_node_t* node = vfs_get_node(f->node_id);
+    if (!node) return -1;
+    int done = vfs_write(node, f->offset - len, f->wbuf, len);
+    return done == (int)len ? 0 : -1;
+}
+
+/**
+ * @brief Flushes every fd with buffered data for a node, so that reads
+ * and copies of the node see it
+ */
+static void flush_node(uint32_t node_id) {
+    for (int i = 0; i < MAX_FDS; i++) {
+        if (fd_table[i].in_use && fd_table[i].node_id == node_id) {
+            flush_fd(&fd_table[i]);
+        }
+    }
+}
+
+void syscall_forget_node(uint32_t node_id) {
+    for (int i = 0; i < MAX_FDS; i++) {
+        if (fd_table[i].in_use && fd_table[i].node_id == node_id) {
+            fd_table[i].wbuf_len = 0;   // Its file is gone
+            fd_table[i].node_id = 0;    // Never a valid ID
+        }
+    }
+}
+
+void syscall_flush_all() {
+    for (int i = 0; i < MAX_FDS; i++) {
+        if (fd_table[i].in_use) flush_fd(&fd_table[i]);
+    }
+}
+
+/**
+ * @brief Returns an open fd's entry, or 0
+ */
+static file_descriptor_t* fd_get(int fd) {
+    return (fd >= 0 && fd < MAX_FDS && fd_table[fd].in_use) ? &fd_table[fd] : 0;
+}
+
+/**
+ * @brief Free a file descriptor, writing out its buffer
+ * @return 0 on success, -1 if buffered data was lost
+ */
+static int free_fd(int fd) {
+    if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].in_use) return -1;
+    int ret = flush_fd(&fd_table[fd]);
+    fd_table[fd].in_use = 0;
+    return ret;
+}
+
+/**
+ * @brief Appends a write to the fd's buffer if it is worth buffering:
+ * small writes to disk files, which otherwise each cost a filesystem
+ * update. Larger writes and other filesystems go straight through.
+ * @return 1 if the data was buffered, 0 if the caller must write it
+ */
+static int buffer_write(file_descriptor_t* f, const char* buf, uint32_t count) {
+    if (f->node_id == 0) return 0;  // Detached: the write fails unbuffered
+    if (count >= FD_WBUF_SIZE || !(vfs_flags(f->node_id) & VFS_CACHED)) {
+        flush_fd(f);
+        return 0;
+    }
+    if (f->wbuf_len + count > FD_WBUF_SIZE) {
+        if (flush_fd(f) != 0) return 0;
+    }
+    if (!f->wbuf) {
+        f->wbuf = (uint8_t*)pmm_alloc_page();
+        if (!f->wbuf) return 0;
+    }
+
+    memcpy(f->wbuf + f->wbuf_len, buf, count);
+    f->wbuf_len += count;
+    f->offset += count;
+    return 1;
+}
+
+/**
+ * @brief Reads at the fd's offset and advances it
+ * @return Bytes read, or -1
+ */
+static int read_fd(file_descriptor_t* f, void* buf, uint32_t count) {
+    flush_node(f->node_id);
+    fs_node_t* node = vfs_get_node(f->node_id);
+    if (!node) return -1;
+
+    // Through the page cache, unless the file already lives in RAM
+    int done = vfs_read(node, f->offset, buf, count);
+    if (done < 0) return -1;
+    f->offset += done;
+    return done;
+}
+
+/**
+ * @brief Writes at the fd's offset and advances it
+ * @return Bytes written, or -1
+ */
+static int write_fd(file_descriptor_t* f, const void* buf, uint32_t count) {
+    // Small writes collect in the fd until close or a full buffer
+    if (buffer_write(f, (const char*)buf, count)) return count;
+
+    fs_node_t* node = vfs_get_node(f->node_id);
+    if (!node) return -1;
+
+    // Write to the file's data blocks (allocated on demand)
+    int done = vfs_write(node, f->offset, buf, count);
+    if (done < 0) return -1;
+    f->offset += done;
+    return done;
+}
+
+/**
+ * @brief Reads at an explicit offset; the fd's offset stays put
+ */
+static int pread_fd(file_descriptor_t* f, void* buf, uint32_t count, uint32_t offset) {
+    flush_node(f->node_id);
+    fs_node_t* node = vfs_get_node(f->node_id);
+    return node ? vfs_read(node, offset, buf, count) : -1;
+}
+
+/**
+ * @brief Writes at an explicit offset; the fd's offset stays put
+ */
+static int pwrite_fd(file_descriptor_t* f, const void* buf, uint32_t count, uint32_t offset) {
+    // Buffered writes go first, so a later pwrite of the same bytes wins
+    flush_node(f->node_id);
+    fs_node_t* node = vfs_get_node(f->node_id);
+    return node ? vfs_write(node, offset, buf, count) : -1;
+}
+
+/**
+ * @brief Makes one file durable: its buffered bytes, then whatever of
+ * it the filesystem still holds back (other fds keep buffering)
+ * @return 0 on success, -1 on error
+ */
+static int sync_fd(file_descriptor_t* f, int datasync) {
+    int err = flush_fd(f);
+    if (vfs_sync(f->node_id, datasync) != 0) err = -1;
+    return err;
+}
+
+/**
+ * @brief Fills a stat record from a node
+ */
+static void fill_stat(const fs_node_t* node, struct stat* st) {
+    st->st_ino = node->id;
+    st->st_parent = node->parent_id;
+    st->st_size = node->size;
+    st->st_blocks = node->blocks * (vfs_block_size(node->id) / 512);
+    st->st_nchildren = node->type == FS_TYPE_DIRECTORY ? node->child_count : 0;
+    st->st_type = node->type;
+    st->st_flags = node->flags;
+    st->st_reserved = 0;
+}
+
+/**
+ * @brief Returns the directory an *at() path is relative to: the one
+ * open on dirfd, or the working directory for AT_FDCWD
+ * @return The directory's ID, or 0 if dirfd is not an open directory
+ */
+static uint32_t at_dir(int dirfd) {
+    if (dirfd == AT_FDCWD) return current_cwd;
+    if (dirfd < 0 || dirfd >= MAX_FDS || !fd_table[dirfd].in_use) return 0;
+    fs_node_t* dir = vfs_get_node(fd_table[dirfd].node_id);
+    return dir && dir->type == FS_TYPE_DIRECTORY ? dir->id : 0;
+}
+
+/**
+ * @brief Resolves all but the last component of a path
+ * @param name Set to the last component (a pointer into path)
+ * @return The parent directory's ID, or 0 if it does not exist
+ */
+static uint32_t find_parent(uint32_t dir_id, const char* path, const char** name) {
+    const char* slash = 0;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/') slash = p;
+    }
+    if (!slash) {
+        *name = path;
+        return dir_id;
+    }
+
+    *name = slash + 1;
+    char parent_path[AT_PATH_MAX];
+    uint32_t len = slash - path;
+    if (len >= AT_PATH_MAX) return 0;
+    if (len == 0) {
+        strcpy(parent_path, "/");
+    } else {
+        memcpy(parent_path, path, len);
+        parent_path[len] = '\0';
+    }
+    fs_node_t* parent = vfs_find_node(parent_path, dir_id);
+    return parent && parent->type == FS_TYPE_DIRECTORY ? parent->id : 0;
+}
+
+/**
+ * @brief Creates a file or directory at a path relative to dir_id
+ * @return The new node's ID, or 0 on failure (including a taken name)
+ */
+static uint32_t create_at(uint32_t dir_id, const char* path, uint8_t type) {
+    const char* name;
+    uint32_t parent_id = find_parent(dir_id, path, &name);
+    uint32_t len = strlen(name);
+    if (!parent_id || len == 0 || len >= FS_MAX_NAME) return 0;
+    if (!vfs_create(parent_id, name, type)) return 0;
+    return vfs_lookup(parent_id, name, len);
+}
+
+/**
+ * @brief Opens a path relative to dir_id, creating a missing file
+ * with O_CREAT
+ * @return The new fd, or -1
+ */
+static int open_at(uint32_t dir_id, const char* path, uint8_t flags) {
+    if (!dir_id) return -1;
+    fs_node_t* node = vfs_find_node(path, dir_id);
+    if (node) return allocate_fd(node->id, flags);
+    if (!(flags & O_CREAT)) return -1;
+
+    uint32_t id = create_at(dir_id, path, FS_TYPE_FILE);
+    return id ? allocate_fd(id, flags) : -1;
+}
+
+/**
+ * @brief Stats a path relative to dir_id
+ * @return 0 on success, -1 if the path does not exist
+ */
+static int stat_at(uint32_t dir_id, const char* path, struct stat* st) {
+    fs_node_t* node = dir_id ? vfs_find_node(path, dir_id) : 0;
+    if (!node) return -1;
+
+    uint32_t id = node->id;
+    flush_node(id);  // Buffered writes count toward the size
+    node = vfs_get_node(id);
+    if (!node) return -1;
+    fill_stat(node, st);
+    return 0;
+}
+
+/**
+ * @brief Copies up to max_count entries, from *cursor on, into a
+ * struct dirent or (plus) struct dirent_plus array
+ * @return Number of entries copied
+ */
+static int read_dirents(uint32_t dir_id, uint32_t* cursor, void* buf, int max_count, int plus) {
+    struct dirent* dirents = (struct dirent*)buf;
+    struct dirent_plus* dirents_plus = (struct dirent_plus*)buf;
+    int count = 0;
+    fs_dirent_t entry;
+
+    if (plus) syscall_flush_all();  // Sizes include buffered writes
+    while (count < max_count && vfs_readdir(dir_id, cursor, &entry)) {
+        if (!plus) {
+            dirents[count].d_ino = entry.id;
+            dirents[count].d_type = entry.type;
+            strcpy(dirents[count].d_name, entry.name);
+            count++;
+            continue;
+        }
+
+        struct dirent_plus* d = &dirents_plus[count++];
+        fs_node_t* node = vfs_get_node(entry.id);
+        if (node) {
+            fill_stat(node, &d->d_stat);
+        } else {
+            memset(&d->d_stat, 0, sizeof(struct stat));
+            d->d_stat.st_ino = entry.id;
+            d->d_stat.st_type = entry.type;
+        }
+        strcpy(d->d_name, entry.name);
+    }
+    return count;
+}
+
+/**
+ * @brief Reads into each segment in turn, stopping at end of file
+ * @return Total bytes read, or -1 if the first read fails
+ */
+static int readv_fd(file_descriptor_t* f, const struct iovec* iov, int iovcnt) {
+    flush_node(f->node_id);
+    uint32_t done = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        fs_node_t* node = vfs_get_node(f->node_id);
+        if (!node) return done > 0 ? (int)done : -1;
+
+        int got = vfs_read(node, f->offset, iov[i].iov_base, iov[i].iov_len);
+        if (got < 0) return done > 0 ? (int)done : -1;
+        f->offset += got;
+        done += got;
+        if ((uint32_t)got < iov[i].iov_len) break;
+    }
+    return done;
+}
+
+/**
+ * @brief Writes all segments as one contiguous write: a small vector
+ * joins the fd's write buffer whole, a larger one is gathered into
+ * IOV_STAGE_PAGES chunks, each a single filesystem update
+ * @return Total bytes written, or -1 if nothing was written
  */
-static void free_fd(int fd) {
-    if (fd >= 0 && fd < MAX_FDS) {
-        fd_table[fd].in_use = 0;
+static int writev_fd(file_descriptor_t* f, const struct iovec* iov, int iovcnt) {
+    uint32_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
     }
+    if (total == 0) return 0;
+
+    if (total < FD_WBUF_SIZE && (vfs_flags(f->node_id) & VFS_CACHED)) {
+        if (f->wbuf_len + total > FD_WBUF_SIZE) flush_fd(f);  // Keep the vector in one flush
+        // With room ensured, only the first segment can fail (no buffer page)
+        int i = 0;
+        while (i < iovcnt && buffer_write(f, iov[i].iov_base, iov[i].iov_len)) i++;
+        if (i == iovcnt) return total;
+    }
+
+    flush_fd(f);
+    if (!iov_stage) {
+        iov_stage = (uint8_t*)pmm_alloc_pages(IOV_STAGE_PAGES);
+        if (!iov_stage) return -1;
+    }
+
+    uint32_t done = 0;
+    int seg = 0;
+    uint32_t seg_off = 0;
+    while (done < total) {
+        // Gather the next chunk
+        uint32_t len = 0;
+        while (seg < iovcnt && len < IOV_STAGE_PAGES * PAGE_SIZE) {
+            uint32_t take = iov[seg].iov_len - seg_off;
+            if (take > IOV_STAGE_PAGES * PAGE_SIZE - len) take = IOV_STAGE_PAGES * PAGE_SIZE - len;
+            memcpy(iov_stage + len, (const uint8_t*)iov[seg].iov_base + seg_off, take);
+            len += take;
+            seg_off += take;
+            if (seg_off == iov[seg].iov_len) {
+                seg++;
+                seg_off = 0;
+            }
+        }
+
+        fs_node_t* node = vfs_get_node(f->node_id);
+        int put = node ? vfs_write(node, f->offset, iov_stage, len) : -1;
+        if (put <= 0) break;
+        f->offset += put;
+        done += put;
+        if ((uint32_t)put < len) break;
+    }
+    return done > 0 ? (int)done : -1;
+}
+
+// --- I/O ring ---
+// The program queues entries in the submission ring and reaps results
+// from the completion ring, both in its own memory. There is no
+// scheduler and the disk is polled, so nothing can run behind the
+// program's back: sys_io_enter runs the whole batch, in submission
+// order, before it returns. Only a full completion ring holds entries
+// back, until the program reaps and enters again. The ring (often on
+// the command's stack) is released when the command returns.
+
+/**
+ * @brief Runs one operation of the ring
+ * @return The result, as the matching syscall would return it
+ */
+static int io_ring_execute(const struct io_uring_sqe* sqe) {
+    if (sqe->opcode == IORING_OP_NOP) return 0;
+    if (sqe->opcode == IORING_OP_OPENAT) {
+        return open_at(at_dir(sqe->fd), (const char*)sqe->addr, (uint8_t)sqe->len);
+    }
+
+    file_descriptor_t* f = fd_get(sqe->fd);
+    if (!f) return -1;
+    switch (sqe->opcode) {
+        case IORING_OP_READ:
+            if (sqe->off == IORING_OFF_CUR) return read_fd(f, sqe->addr, sqe->len);
+            return pread_fd(f, sqe->addr, sqe->len, sqe->off);
+        case IORING_OP_WRITE:
+            if (sqe->off == IORING_OFF_CUR) return write_fd(f, sqe->addr, sqe->len);
+            return pwrite_fd(f, sqe->addr, sqe->len, sqe->off);
+        case IORING_OP_FSYNC:
+            return sync_fd(f, sqe->flags & IORING_FSYNC_DATASYNC);
+        case IORING_OP_CLOSE:
+            return free_fd(sqe->fd);
+    }
+    return -1;
+}
+
+/**
+ * @brief Runs the oldest submitted entry and posts its completion
+ * @return 1 if an entry ran, 0 if none is pending or the completion
+ * ring is full
+ */
+static int io_ring_run_one() {
+    if (!ring || ring->sq_head == ring_submitted) return 0;
+    if (ring->cq_tail - ring->cq_head >= IORING_CQ_ENTRIES) return 0;  // Wait for the program to reap
+
+    const struct io_uring_sqe* sqe = &ring->sqes[ring->sq_head % IORING_ENTRIES];
+    struct io_uring_cqe* cqe = &ring->cqes[ring->cq_tail % IORING_CQ_ENTRIES];
+    cqe->user_data = sqe->user_data;
+    cqe->res = io_ring_execute(sqe);
+    ring->sq_head++;    // The slot may be reused from here
+    ring->cq_tail++;    // Visible to the program without a syscall
+    return 1;
+}
+
+void syscall_io_release() {
+    ring = 0;  // Entries still submitted are dropped unrun
+    ring_submitted = 0;
 }
 
 /**
@@ -81,13 +547,16 @@ static void free_fd(int fd) {
  *   ESI = arg4
  *   EDI = arg5
  *
- * Return value in EAX
+ * @return The value the wrapper hands back in EAX
  */
-void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
+uint32_t syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
                      uint32_t edx, uint32_t esi, uint32_t edi) {
     uint32_t syscall_num = eax;
     uint32_t ret = 0;
 
+    interrupt_counts[0x80]++;
+    if (syscall_num < SYS_COUNT) syscall_counts[syscall_num]++;
+
     switch (syscall_num) {
         case SYS_PRINT: {
             // sys_print(const char* str)
@@ -102,13 +571,17 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
             char* path = (char*)ebx;
             uint8_t flags = (uint8_t)ecx;
 
-            fs_node_t* node = fs_find_node(path, current_cwd);
-            if (!node) {
-                ret = -1;  // File not found
-            } else {
-                int fd = allocate_fd(node->id, flags);
-                ret = fd;
-            }
+            ret = open_at(current_cwd, path, flags);
+            break;
+        }
+
+        case SYS_OPENAT: {
+            // sys_openat(int dirfd, const char* path, int flags)
+            int dirfd = (int)ebx;
+            char* path = (char*)ecx;
+            uint8_t flags = (uint8_t)edx;
+
+            ret = open_at(at_dir(dirfd), path, flags);
             break;
         }
 
@@ -118,32 +591,8 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
             char* buf = (char*)ecx;
             uint32_t count = edx;
 
-            if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].in_use) {
-                ret = -1;
-                break;
-            }
-
-            fs_node_t* node = fs_get_node(fd_table[fd].node_id);
-            if (!node) {
-                ret = -1;
-                break;
-            }
-
-            // Read from file's padding area (simple implementation)
-            uint32_t offset = fd_table[fd].offset;
-            uint32_t bytes_to_read = count;
-            if (offset + bytes_to_read > node->size) {
-                bytes_to_read = node->size - offset;
-            }
-
-            // Copy data
-            char* file_data = (char*)node->padding;
-            for (uint32_t i = 0; i < bytes_to_read; i++) {
-                buf[i] = file_data[offset + i];
-            }
-
-            fd_table[fd].offset += bytes_to_read;
-            ret = bytes_to_read;
+            file_descriptor_t* f = fd_get(fd);
+            ret = f ? read_fd(f, buf, count) : -1;
             break;
         }
 
@@ -153,44 +602,45 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
             const char* buf = (const char*)ecx;
             uint32_t count = edx;
 
-            if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].in_use) {
-                ret = -1;
-                break;
-            }
+            file_descriptor_t* f = fd_get(fd);
+            ret = f ? write_fd(f, buf, count) : -1;
+            break;
+        }
+
+        case SYS_READV: {
+            // sys_readv(int fd, const struct iovec* iov, int iovcnt)
+            int fd = (int)ebx;
+            const struct iovec* iov = (const struct iovec*)ecx;
+            int iovcnt = (int)edx;
 
-            fs_node_t* node = fs_get_node(fd_table[fd].node_id);
-            if (!node) {
+            if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].in_use ||
+                iovcnt <= 0 || iovcnt > IOV_MAX) {
                 ret = -1;
                 break;
             }
+            ret = readv_fd(&fd_table[fd], iov, iovcnt);
+            break;
+        }
 
-            // Write to file's padding area
-            uint32_t offset = fd_table[fd].offset;
-            uint32_t bytes_to_write = count;
-            if (offset + bytes_to_write > 400) {  // Max padding size
-                bytes_to_write = 400 - offset;
-            }
-
-            char* file_data = (char*)node->padding;
-            for (uint32_t i = 0; i < bytes_to_write; i++) {
-                file_data[offset + i] = buf[i];
-            }
+        case SYS_WRITEV: {
+            // sys_writev(int fd, const struct iovec* iov, int iovcnt)
+            int fd = (int)ebx;
+            const struct iovec* iov = (const struct iovec*)ecx;
+            int iovcnt = (int)edx;
 
-            if (offset + bytes_to_write > node->size) {
-                node->size = offset + bytes_to_write;
+            if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].in_use ||
+                iovcnt <= 0 || iovcnt > IOV_MAX) {
+                ret = -1;
+                break;
             }
-
-            fd_table[fd].offset += bytes_to_write;
-            fs_update_node(node);
-            ret = bytes_to_write;
+            ret = writev_fd(&fd_table[fd], iov, iovcnt);
             break;
         }
 
         case SYS_CLOSE: {
             // sys_close(int fd)
             int fd = (int)ebx;
-            free_fd(fd);
-            ret = 0;
+            ret = free_fd(fd);
             break;
         }
 
@@ -201,9 +651,9 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
 
             // Build path string
             // For simplicity, just return the current directory name
-            fs_node_t* cwd = fs_get_node(current_cwd);
+            fs_node_t* cwd = vfs_get_node(current_cwd);
             if (cwd) {
-                if (current_cwd == fs_root_id) {
+                if (current_cwd == vfs_root_id) {
                     strcpy(buf, "/");
                 } else {
                     strcpy(buf, "/");
@@ -220,7 +670,7 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
             // sys_chdir(const char* path)
             char* path = (char*)ebx;
 
-            fs_node_t* target = fs_find_node(path, current_cwd);
+            fs_node_t* target = vfs_find_node(path, current_cwd);
             if (target && target->type == FS_TYPE_DIRECTORY) {
                 current_cwd = target->id;
                 ret = 0;
@@ -234,13 +684,17 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
             // sys_mkdir(const char* path)
             char* path = (char*)ebx;
 
-            // Parse parent directory and new dir name
-            // Simplified: assume path is just the name in current directory
-            if (fs_create_node(current_cwd, path, FS_TYPE_DIRECTORY)) {
-                ret = 0;
-            } else {
-                ret = -1;
-            }
+            ret = create_at(current_cwd, path, FS_TYPE_DIRECTORY) ? 0 : -1;
+            break;
+        }
+
+        case SYS_MKDIRAT: {
+            // sys_mkdirat(int dirfd, const char* path)
+            int dirfd = (int)ebx;
+            char* path = (char*)ecx;
+
+            uint32_t dir_id = at_dir(dirfd);
+            ret = dir_id && create_at(dir_id, path, FS_TYPE_DIRECTORY) ? 0 : -1;
             break;
         }
 
@@ -248,9 +702,9 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
             // sys_rmdir(const char* path)
             char* path = (char*)ebx;
 
-            fs_node_t* target = fs_find_node(path, current_cwd);
+            fs_node_t* target = vfs_find_node(path, current_cwd);
             if (target && target->type == FS_TYPE_DIRECTORY) {
-                if (fs_delete_node(target->id)) {
+                if (vfs_delete(target->id)) {
                     ret = 0;
                 } else {
                     ret = -1;
@@ -265,11 +719,7 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
             // sys_create_file(const char* path)
             char* path = (char*)ebx;
 
-            if (fs_create_node(current_cwd, path, FS_TYPE_FILE)) {
-                ret = 0;
-            } else {
-                ret = -1;
-            }
+            ret = create_at(current_cwd, path, FS_TYPE_FILE) ? 0 : -1;
             break;
         }
 
@@ -279,27 +729,279 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
             struct dirent* dirents = (struct dirent*)ecx;
             int max_count = (int)edx;
 
-            fs_node_t* dir = fs_find_node(path, current_cwd);
+            fs_node_t* dir = vfs_find_node(path, current_cwd);
             if (!dir || dir->type != FS_TYPE_DIRECTORY) {
                 ret = -1;
                 break;
             }
 
             // Copy directory entries
-            int count = dir->child_count;
-            if (count > max_count) count = max_count;
-
-            for (int i = 0; i < count; i++) {
-                uint32_t child_id = dir->child_ids[i];
-                fs_node_t* child = fs_get_node(child_id);
-                if (child) {
-                    dirents[i].d_ino = child->id;
-                    dirents[i].d_type = child->type;
-                    strcpy(dirents[i].d_name, child->name);
+            uint32_t cursor = 0;
+            ret = read_dirents(dir->id, &cursor, dirents, max_count, 0);
+            break;
+        }
+
+        case SYS_GETDENTS_FD:
+        case SYS_GETDENTS_PLUS_FD: {
+            // sys_getdents_fd(int fd, struct dirent* buf, int count)
+            // sys_getdents_plus_fd(int fd, struct dirent_plus* buf, int count)
+            int fd = (int)ebx;
+            void* buf = (void*)ecx;
+            int max_count = (int)edx;
+
+            if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].in_use) {
+                ret = -1;
+                break;
+            }
+            fs_node_t* dir = vfs_get_node(fd_table[fd].node_id);
+            if (!dir || dir->type != FS_TYPE_DIRECTORY) {
+                ret = -1;
+                break;
+            }
+
+            // The fd offset holds the filesystem's readdir cursor, so each
+            // call resumes where the last one stopped (lseek to 0 rewinds)
+            ret = read_dirents(dir->id, &fd_table[fd].offset, buf, max_count,
+                               syscall_num == SYS_GETDENTS_PLUS_FD);
+            break;
+        }
+
+        case SYS_STAT: {
+            // sys_stat(const char* path, struct stat* st)
+            char* path = (char*)ebx;
+            struct stat* st = (struct stat*)ecx;
+
+            ret = stat_at(current_cwd, path, st);
+            break;
+        }
+
+        case SYS_FSTATAT: {
+            // sys_fstatat(int dirfd, const char* path, struct stat* st)
+            int dirfd = (int)ebx;
+            char* path = (char*)ecx;
+            struct stat* st = (struct stat*)edx;
+
+            ret = stat_at(at_dir(dirfd), path, st);
+            break;
+        }
+
+        case SYS_GETDENTS_PLUS: {
+            // sys_getdents_plus(const char* path, struct dirent_plus* buf, int count)
+            char* path = (char*)ebx;
+            struct dirent_plus* dirents = (struct dirent_plus*)ecx;
+            int max_count = (int)edx;
+
+            fs_node_t* dir = vfs_find_node(path, current_cwd);
+            if (!dir || dir->type != FS_TYPE_DIRECTORY) {
+                ret = -1;
+                break;
+            }
+
+            uint32_t cursor = 0;
+            ret = read_dirents(dir->id, &cursor, dirents, max_count, 1);
+            break;
+        }
+
+        case SYS_MMAP: {
+            // sys_mmap(int fd, size_t length, uint32_t offset)
+            int fd = (int)ebx;
+            uint32_t length = ecx;
+            uint32_t offset = edx;
+
+            if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].in_use ||
+                (fd_table[fd].flags & O_WRONLY)) {
+                ret = 0;
+                break;
+            }
+
+            // The caller gets the cached pages themselves, not a copy
+            flush_node(fd_table[fd].node_id);
+            ret = (uint32_t)pcache_map(fd_table[fd].node_id, offset, length);
+            break;
+        }
+
+        case SYS_MUNMAP: {
+            // sys_munmap(void* addr, size_t length)
+            ret = pcache_unmap((void*)ebx, ecx);
+            break;
+        }
+
+        case SYS_COPY_FILE_RANGE: {
+            // sys_copy_file_range(int fd_in, int fd_out, size_t count)
+            int fd_in = (int)ebx;
+            int fd_out = (int)ecx;
+            uint32_t count = edx;
+
+            if (fd_in < 0 || fd_in >= MAX_FDS || !fd_table[fd_in].in_use ||
+                fd_out < 0 || fd_out >= MAX_FDS || !fd_table[fd_out].in_use) {
+                ret = -1;
+                break;
+            }
+
+            flush_node(fd_table[fd_in].node_id);
+            flush_node(fd_table[fd_out].node_id);
+            fs_node_t* src = vfs_get_node(fd_table[fd_in].node_id);
+            fs_node_t* dst = vfs_get_node(fd_table[fd_out].node_id);
+            if (!src || !dst) {
+                ret = -1;
+                break;
+            }
+
+            // The data never leaves the kernel. Both nodes go in as stack
+            // copies: the cache slots behind src and dst can be recycled
+            // by the I/O the copy does.
+            fs_node_t src_copy = *src;
+            fs_node_t dst_copy = *dst;
+            int copied = vfs_copy_range(&src_copy, fd_table[fd_in].offset,
+                                       &dst_copy, fd_table[fd_out].offset, count);
+            if (copied < 0) {
+                ret = -1;
+                break;
+            }
+
+            fd_table[fd_in].offset += copied;
+            fd_table[fd_out].offset += copied;
+            ret = copied;
+            break;
+        }
+
+        case SYS_REFLINK: {
+            // sys_reflink(const char* src, const char* name)
+            char* src_path = (char*)ebx;
+            char* name = (char*)ecx;
+
+            fs_node_t* src = vfs_find_node(src_path, current_cwd);
+            uint32_t src_id = src ? src->id : 0;
+            if (src_id) flush_node(src_id);
+            const char* leaf;
+            uint32_t parent_id = src_id ? find_parent(current_cwd, name, &leaf) : 0;
+            if (parent_id && vfs_clone(src_id, parent_id, leaf)) {
+                ret = 0;
+            } else {
+                ret = -1;
+            }
+            break;
+        }
+
+        case SYS_FSYNC:
+        case SYS_FDATASYNC: {
+            // sys_fsync(int fd), sys_fdatasync(int fd)
+            int fd = (int)ebx;
+
+            file_descriptor_t* f = fd_get(fd);
+            ret = f ? sync_fd(f, syscall_num == SYS_FDATASYNC) : -1;
+            break;
+        }
+
+        case SYS_IO_SETUP: {
+            // sys_io_setup(struct io_uring* r): registers the ring (0 drops it)
+            struct io_uring* r = (struct io_uring*)ebx;
+
+            // Entries still pending in the old ring run first
+            while (io_ring_run_one()) {
+            }
+            ring = r;
+            ring_submitted = 0;
+            if (r) {
+                memset(r, 0, sizeof(struct io_uring));
+            }
+            ret = 0;
+            break;
+        }
+
+        case SYS_IO_ENTER: {
+            // sys_io_enter(uint32_t to_submit)
+            uint32_t to_submit = ebx;
+
+            if (!ring) {
+                ret = -1;
+                break;
+            }
+            uint32_t queued = ring->sq_tail - ring_submitted;
+            if (ring->sq_tail - ring->sq_head > IORING_ENTRIES) queued = 0;  // Bad tail: take nothing
+            if (to_submit > queued) to_submit = queued;
+            ring_submitted += to_submit;
+
+            // A full completion ring stops the loop; the rest runs on the
+            // next call (to_submit may be 0)
+            while (io_ring_run_one()) {
+            }
+            ret = to_submit;
+            break;
+        }
+
+        case SYS_LSEEK: {
+            // sys_lseek(int fd, int offset, int whence)
+            int fd = (int)ebx;
+            int32_t offset = (int32_t)ecx;
+            uint32_t whence = edx;
+
+            if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].in_use) {
+                ret = -1;
+                break;
+            }
+
+            // Buffered data belongs at the old offset
+            file_descriptor_t* f = &fd_table[fd];
+            flush_fd(f);
+
+            int32_t base;
+            if (whence == SEEK_SET) {
+                base = 0;
+            } else if (whence == SEEK_CUR) {
+                base = (int32_t)f->offset;
+            } else if (whence == SEEK_END) {
+                flush_node(f->node_id);  // Other fds may extend the file
+                fs_node_t* node = vfs_get_node(f->node_id);
+                if (!node) {
+                    ret = -1;
+                    break;
                 }
+                base = (int32_t)node->size;
+            } else {
+                ret = -1;
+                break;
+            }
+
+            if (base + offset < 0) {
+                ret = -1;
+                break;
             }
 
-            ret = count;
+            // A directory's offset is its readdir cursor: only a rewind or
+            // the cursor getdents left it at is a valid position
+            fs_node_t* node = vfs_get_node(f->node_id);
+            if (node && node->type == FS_TYPE_DIRECTORY &&
+                base + offset != 0 && (uint32_t)(base + offset) != f->offset) {
+                ret = -1;
+                break;
+            }
+            f->offset = base + offset;
+            ret = f->offset;
+            break;
+        }
+
+        case SYS_PREAD: {
+            // sys_pread(int fd, void* buf, size_t count, uint32_t offset)
+            int fd = (int)ebx;
+            char* buf = (char*)ecx;
+            uint32_t count = edx;
+            uint32_t offset = esi;
+
+            file_descriptor_t* f = fd_get(fd);
+            ret = f ? pread_fd(f, buf, count, offset) : -1;
+            break;
+        }
+
+        case SYS_PWRITE: {
+            // sys_pwrite(int fd, const void* buf, size_t count, uint32_t offset)
+            int fd = (int)ebx;
+            const char* buf = (const char*)ecx;
+            uint32_t count = edx;
+            uint32_t offset = esi;
+
+            file_descriptor_t* f = fd_get(fd);
+            ret = f ? pwrite_fd(f, buf, count, offset) : -1;
             break;
         }
 
@@ -329,9 +1031,15 @@ void syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx,
             break;
     }
 
-    // Return value is passed back in EAX
-    // This will be handled by the assembly wrapper
-    __asm__ volatile("mov %0, %%eax" : : "r"(ret));
+    return ret;
+}
+
+uint32_t syscall_get_count(uint32_t num) {
+    return num < SYS_COUNT ? syscall_counts[num] : 0;
+}
+
+const char* syscall_get_name(uint32_t num) {
+    return num < SYS_COUNT ? syscall_names[num] : 0;
 }
 
 // Assembly wrapper for system call interrupt
@@ -347,6 +1055,7 @@ __asm__(
     "   push %eax\n"
     "   call syscall_handler\n"
     "   add $24, %esp\n"            // Clean up stack (6 args * 4 bytes)
-    "   popa\n"                     // Restore registers (includes EAX with return value)
+    "   mov %eax, 28(%esp)\n"       // Return value over the saved EAX
+    "   popa\n"                     // Restore registers, EAX = return value
     "   iret\n"
 );
@@ -14,11 +14,8 @@
 #define CTRL_S 0x13
 #define CTRL_X 0x18
 
-// Helper macro to access the content area of the node (using the padding)
-// We treat the padding bytes as the raw file content storage.
-#define NODE_CONTENT(node) ((char*)((node)->padding))
-// Calculate max safe size based on the struct definition
-#define MAX_EDITOR_SIZE (sizeof(((fs_node_t*)0)->padding) - 1)
+// File contents live in data blocks; the editor holds one sector's worth.
+#define MAX_EDITOR_SIZE 511
 
 // --- Helper Functions ---
 
@@ -49,7 +46,7 @@ static void read_line(char* buffer, int max_len) {
 
 void text_editor(const char* edit_filename) {
     // We use a stack buffer. Ensure it doesn't exceed stack limits.
-    // For this simple FS, size is limited to ~300 bytes anyway.
+    // Files larger than MAX_EDITOR_SIZE are opened truncated.
     char editor_buffer[512];
     size_t current_len = 0;
 
@@ -70,13 +67,13 @@ void text_editor(const char* edit_filename) {
                 return;
             }
 
-            // Load content from the node's internal storage
+            // Load content from the node's data blocks
             strcpy(initial_filename, target_node->name);
-            char* content = NODE_CONTENT(target_node);
+            int loaded = fs_read(target_node, 0, editor_buffer, MAX_EDITOR_SIZE);
+            if (loaded < 0) loaded = 0;
 
-            // Safety copy
-            strncpy(editor_buffer, content, MAX_EDITOR_SIZE);
-            editor_buffer[MAX_EDITOR_SIZE] = '\0';
+            // Safety terminate
+            editor_buffer[loaded] = '\0';
             current_len = strlen(editor_buffer);
         } else {
             // New file setup
@@ -166,15 +163,16 @@ void text_editor(const char* edit_filename) {
              return;
         }
 
-        // Write buffer to node padding
-        char* node_storage = NODE_CONTENT(final_node);
-        memset(node_storage, 0, sizeof(final_node->padding)); // Clear old
-        strncpy(node_storage, editor_buffer, current_len);
+        // Write buffer to the node's data blocks
+        uint32_t final_id = final_node->id;
+        int written = current_len > 0 ? fs_write(final_node, 0, editor_buffer, current_len) : 0;
 
-        final_node->size = current_len;
+        // Drop any old tail beyond the new content
+        final_node = fs_get_node(final_id);
+        if (final_node) final_node->size = current_len;
 
         // Persist to Disk
-        if (fs_update_node(final_node)) {
+        if (written >= 0 && fs_update_node(final_node)) {
             console_print_colored("File updated successfully.\n", COLOR_GREEN_ON_BLACK);
         } else {
             console_print_colored("Error writing to disk.\n", COLOR_LIGHT_RED);
@@ -190,13 +188,8 @@ void text_editor(const char* edit_filename) {
             final_node = fs_get_node(new_id);
 
             if (final_node) {
-                // 3. Fill Content
-                char* node_storage = NODE_CONTENT(final_node);
-                strncpy(node_storage, editor_buffer, current_len);
-                final_node->size = current_len;
-
-                // 4. Persist
-                fs_update_node(final_node);
+                // 3. Fill Content and 4. Persist
+                fs_write(final_node, 0, editor_buffer, current_len);
                 console_print_colored("File created and saved.\n", COLOR_GREEN_ON_BLACK);
             } else {
                 console_print_colored("Error retrieving new file handle.\n", COLOR_LIGHT_RED);
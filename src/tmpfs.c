@@ -0,0 +1,293 @@
+/**
+ * src/tmpfs.c - RAM-backed filesystem
+ * Nodes are fs_node_t records in one page-allocated table. File data
+ * lives in whole pages, reached through the same direct[] and indirect
+ * fields the disk format uses for sectors. Nothing here touches the disk,
+ * and the contents are gone after a reboot.
+ */
+
+#include "../include/tmpfs.h"
+#include "../include/string.h"
+#include "../include/memory.h"
+#include "../include/console.h"
+
+#define TMPFS_BUCKETS       256
+#define TMPFS_PTRS_PER_PAGE (PAGE_SIZE / 4)
+#define TMPFS_FILE_PAGES    (FS_DIRECT_BLOCKS + TMPFS_PTRS_PER_PAGE)  // Largest file
+#define TMPFS_TABLE_PAGES   ((TMPFS_MAX_NODES * sizeof(fs_node_t) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+static fs_node_t* nodes = 0;                // id == 0 marks a free slot
+static uint32_t buckets[TMPFS_BUCKETS];     // Name hash chains (index + 1, linked through spare)
+static uint32_t node_count = 0;
+static uint32_t high_water = 0;             // All used slots lie below this
+static uint32_t next_free = 0;              // Next-fit hint
+static uint32_t used_pages = 0;
+static uint32_t limit_pages = 0;
+
+static fs_node_t* tmpfs_node(uint32_t id) {
+    if (!nodes || VFS_TAG(id) != TMPFS_TAG) return 0;
+    uint32_t index = id & ~TMPFS_ID_BASE;
+    if (index >= TMPFS_MAX_NODES || nodes[index].id != id) return 0;
+    return &nodes[index];
+}
+
+static uint32_t tmpfs_hash(uint32_t parent_id, const char* name, uint32_t len) {
+    return (fs_name_hash(name, len) ^ parent_id) % TMPFS_BUCKETS;
+}
+
+/**
+ * @brief Allocates a zeroed page and charges it to a node
+ * @return The page, or 0 once the size limit is reached
+ */
+static void* alloc_page(fs_node_t* node) {
+    if (used_pages >= limit_pages) return 0;
+    void* page = pmm_alloc_page();
+    if (!page) return 0;
+    used_pages++;
+    node->blocks++;
+    return page;
+}
+
+/**
+ * @brief Finds the pointer to page p of a file
+ * @param alloc 1 = create the pointer page if it is missing
+ * @return Address of the pointer, or 0 if there is none
+ */
+static uint32_t* page_slot(fs_node_t* node, uint32_t p, int alloc) {
+    if (p < FS_DIRECT_BLOCKS) return &node->direct[p];
+    p -= FS_DIRECT_BLOCKS;
+    if (p >= TMPFS_PTRS_PER_PAGE) return 0;
+
+    if (node->indirect == 0) {
+        if (!alloc) return 0;
+        void* table = alloc_page(node);
+        if (!table) return 0;
+        node->indirect = (uint32_t)table;
+    }
+    return (uint32_t*)node->indirect + p;
+}
+
+static void free_pages(fs_node_t* node) {
+    for (uint32_t i = 0; i < FS_DIRECT_BLOCKS; i++) {
+        if (node->direct[i]) pmm_free_page((void*)node->direct[i]);
+        node->direct[i] = 0;
+    }
+    if (node->indirect) {
+        uint32_t* table = (uint32_t*)node->indirect;
+        for (uint32_t i = 0; i < TMPFS_PTRS_PER_PAGE; i++) {
+            if (table[i]) pmm_free_page((void*)table[i]);
+        }
+        pmm_free_page(table);
+        node->indirect = 0;
+    }
+    used_pages -= node->blocks;
+    node->blocks = 0;
+}
+
+int tmpfs_init(const char* name, uint32_t limit_kb) {
+    if (nodes) {
+        // Remount: the old contents go
+        for (uint32_t i = 0; i < high_water; i++) {
+            if (nodes[i].id) free_pages(&nodes[i]);
+        }
+        for (uint32_t i = 0; i < TMPFS_TABLE_PAGES; i++) {
+            pmm_free_page((uint8_t*)nodes + i * PAGE_SIZE);
+        }
+    }
+
+    nodes = (fs_node_t*)pmm_alloc_pages(TMPFS_TABLE_PAGES);
+    if (!nodes) {
+        console_print_colored("tmpfs: Out of memory.\n", COLOR_LIGHT_RED);
+        return 0;
+    }
+    memset(buckets, 0, sizeof(buckets));
+    used_pages = 0;
+    limit_pages = limit_kb / (PAGE_SIZE / 1024);
+
+    fs_node_t* root = &nodes[0];
+    root->id = TMPFS_ROOT_ID;
+    root->parent_id = TMPFS_ROOT_ID;  // The VFS takes ".." out of the mount
+    root->type = FS_TYPE_DIRECTORY;
+    strncpy(root->name, name, FS_MAX_NAME - 1);
+    node_count = 1;
+    high_water = 1;
+    next_free = 1;
+    return 1;
+}
+
+fs_node_t* tmpfs_get_node(uint32_t id) {
+    return tmpfs_node(id);
+}
+
+uint32_t tmpfs_lookup(uint32_t dir_id, const char* name, uint32_t len) {
+    if (!nodes || len == 0 || len >= FS_MAX_NAME) return 0;
+
+    for (uint32_t i = buckets[tmpfs_hash(dir_id, name, len)]; i != 0; i = nodes[i - 1].spare) {
+        fs_node_t* node = &nodes[i - 1];
+        if (node->parent_id == dir_id && memcmp(node->name, name, len) == 0 && node->name[len] == '\0') {
+            return node->id;
+        }
+    }
+    return 0;
+}
+
+int tmpfs_create(uint32_t parent_id, const char* name, uint8_t type) {
+    fs_node_t* parent = tmpfs_node(parent_id);
+    uint32_t len = strlen(name);
+    if (!parent || parent->type != FS_TYPE_DIRECTORY) return 0;
+    if (tmpfs_lookup(parent_id, name, len) != 0) return 0;  // Name taken or invalid
+    if (node_count >= TMPFS_MAX_NODES) {
+        console_print_colored("tmpfs: Too many files.\n", COLOR_LIGHT_RED);
+        return 0;
+    }
+
+    uint32_t index = next_free;
+    while (nodes[index].id != 0) {
+        index = (index + 1) % TMPFS_MAX_NODES;
+    }
+
+    fs_node_t* node = &nodes[index];
+    memset(node, 0, sizeof(fs_node_t));
+    node->id = TMPFS_ID_BASE | index;
+    node->parent_id = parent_id;
+    node->type = type;
+    memcpy(node->name, name, len);
+
+    uint32_t h = tmpfs_hash(parent_id, name, len);
+    node->spare = buckets[h];
+    buckets[h] = index + 1;
+
+    parent->child_count++;
+    node_count++;
+    if (index >= high_water) high_water = index + 1;
+    next_free = (index + 1) % TMPFS_MAX_NODES;
+    return 1;
+}
+
+int tmpfs_delete(uint32_t id) {
+    fs_node_t* node = tmpfs_node(id);
+    if (!node || id == TMPFS_ROOT_ID) return 0;
+    if (node->type == FS_TYPE_DIRECTORY && node->child_count > 0) return 0;
+
+    // Unlink from the hash chain
+    uint32_t index = (id & ~TMPFS_ID_BASE) + 1;
+    uint32_t* link = &buckets[tmpfs_hash(node->parent_id, node->name, strlen(node->name))];
+    while (*link != 0 && *link != index) {
+        link = &nodes[*link - 1].spare;
+    }
+    if (*link == index) *link = node->spare;
+
+    fs_node_t* parent = tmpfs_node(node->parent_id);
+    if (parent) parent->child_count--;
+
+    free_pages(node);
+    node->id = 0;
+    node_count--;
+    return 1;
+}
+
+int tmpfs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count) {
+    fs_node_t* n = node ? tmpfs_node(node->id) : 0;
+    if (!n) return -1;
+    if (offset >= n->size) return 0;
+    if (count > n->size - offset) count = n->size - offset;
+
+    uint8_t* out = (uint8_t*)buf;
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t in_page = pos % PAGE_SIZE;
+        uint32_t chunk = PAGE_SIZE - in_page;
+        if (chunk > count - done) chunk = count - done;
+
+        uint32_t* slot = page_slot(n, pos / PAGE_SIZE, 0);
+        if (!slot || *slot == 0) {
+            memset(out + done, 0, chunk);  // Never written
+        } else {
+            memcpy(out + done, (uint8_t*)*slot + in_page, chunk);
+        }
+        done += chunk;
+    }
+    return done;
+}
+
+int tmpfs_write(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count) {
+    fs_node_t* n = node ? tmpfs_node(node->id) : 0;
+    if (!n || n->type != FS_TYPE_FILE) return -1;
+    if (count == 0) return 0;
+
+    const uint8_t* in = (const uint8_t*)buf;
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t pos = offset + done;
+        uint32_t in_page = pos % PAGE_SIZE;
+        uint32_t chunk = PAGE_SIZE - in_page;
+        if (chunk > count - done) chunk = count - done;
+
+        if (pos / PAGE_SIZE >= TMPFS_FILE_PAGES) {
+            console_print_colored("tmpfs: File too large.\n", COLOR_LIGHT_RED);
+            break;
+        }
+        uint32_t* slot = page_slot(n, pos / PAGE_SIZE, 1);
+        if (slot && *slot == 0) *slot = (uint32_t)alloc_page(n);
+        if (!slot || *slot == 0) {
+            console_print_colored("tmpfs: No space left.\n", COLOR_LIGHT_RED);
+            break;
+        }
+
+        memcpy((uint8_t*)*slot + in_page, in + done, chunk);
+        done += chunk;
+    }
+
+    if (offset + done > n->size) {
+        n->size = offset + done;
+    }
+    return done > 0 ? (int)done : -1;
+}
+
+int tmpfs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out) {
+    fs_node_t* dir = tmpfs_node(dir_id);
+    if (!dir || dir->type != FS_TYPE_DIRECTORY) return 0;
+
+    // The cursor is a slot index into the node table
+    while (*cursor < high_water) {
+        fs_node_t* node = &nodes[(*cursor)++];
+        if (node->id != 0 && node->parent_id == dir_id && node->id != dir_id) {
+            out->id = node->id;
+            out->type = node->type;
+            strcpy(out->name, node->name);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void tmpfs_get_stats(uint32_t* nodes_used, uint32_t* max_nodes, uint32_t* used_kb, uint32_t* limit_kb) {
+    *nodes_used = node_count;
+    *max_nodes = TMPFS_MAX_NODES;
+    *used_kb = used_pages * (PAGE_SIZE / 1024);
+    *limit_kb = limit_pages * (PAGE_SIZE / 1024);
+}
+
+void tmpfs_get_space(uint32_t* total_kb, uint32_t* used_kb, uint32_t* free_kb) {
+    *total_kb = limit_pages * (PAGE_SIZE / 1024);
+    *used_kb = used_pages * (PAGE_SIZE / 1024);
+    *free_kb = *total_kb - *used_kb;
+}
+
+const vfs_ops_t tmpfs_ops = {
+    .name       = "tmpfs",
+    .flags      = 0,
+    .block_size = PAGE_SIZE,
+    .get_node   = tmpfs_get_node,
+    .lookup     = tmpfs_lookup,
+    .create     = tmpfs_create,
+    .remove     = tmpfs_delete,
+    .read       = tmpfs_read,
+    .write      = tmpfs_write,
+    .readdir    = tmpfs_readdir,
+    .copy_range = 0,
+    .clone      = 0,
+    .get_space  = tmpfs_get_space,
+    .sync       = 0,
+};
@@ -0,0 +1,253 @@
+/**
+ * src/vfs.c - Virtual filesystem switch
+ * Routes every file operation to the filesystem that owns the node (the
+ * tag in the top bits of its ID) and splices mounted filesystems into
+ * path lookups. The disk path pays one table load and an indirect call
+ * per operation, plus a one-bit test per path component for mount points.
+ */
+
+#include "../include/vfs.h"
+#include "../include/tmpfs.h"
+#include "../include/procfs.h"
+#include "../include/devfs.h"
+#include "../include/pagecache.h"
+#include "../include/syscall.h"
+#include "../include/string.h"
+#include "../include/memory.h"
+
+#define VFS_COPY_PAGES 16   // Buffer for copies across filesystems
+
+uint32_t vfs_root_id = FS_ROOT_ID;
+
+static const vfs_ops_t* fs_types[VFS_MAX_TAGS];    // Owner of each ID tag
+static vfs_mount_t mounts[VFS_MAX_MOUNTS];          // mounts[0] is "/"
+static uint32_t mount_count = 0;
+static uint32_t covered_bits = 0;                   // Bit (id % 32) of every covered directory
+static uint8_t* copy_buf = 0;
+
+static const vfs_ops_t* ops_of(uint32_t id) {
+    return fs_types[VFS_TAG(id)];
+}
+
+/**
+ * @brief Replaces a covered directory by the root mounted on it
+ */
+static uint32_t cross_mount(uint32_t id) {
+    if (!(covered_bits & (1u << (id % 32)))) return id;  // Most lookups stop here
+    for (uint32_t i = 1; i < mount_count; i++) {
+        if (mounts[i].covered_id == id) return mounts[i].root_id;
+    }
+    return id;
+}
+
+static vfs_mount_t* mount_of_root(uint32_t id) {
+    for (uint32_t i = 0; i < mount_count; i++) {
+        if (mounts[i].root_id == id) return &mounts[i];
+    }
+    return 0;
+}
+
+void vfs_init() {
+    memset(fs_types, 0, sizeof(fs_types));
+    mount_count = 0;
+    covered_bits = 0;
+
+    vfs_mount("/", &disk_fs_ops, fs_root_id);
+
+    // /tmp lives in RAM; the disk directory only marks the spot
+    if (!vfs_find_node("/tmp", vfs_root_id)) {
+        vfs_create(vfs_root_id, "tmp", FS_TYPE_DIRECTORY);
+    }
+    if (tmpfs_init("tmp", TMPFS_DEFAULT_LIMIT_KB)) {
+        vfs_mount("/tmp", &tmpfs_ops, TMPFS_ROOT_ID);
+    }
+
+    if (!vfs_find_node("/proc", vfs_root_id)) {
+        vfs_create(vfs_root_id, "proc", FS_TYPE_DIRECTORY);
+    }
+    if (procfs_init("proc")) {
+        vfs_mount("/proc", &procfs_ops, PROCFS_ROOT_ID);
+    }
+
+    if (!vfs_find_node("/dev", vfs_root_id)) {
+        vfs_create(vfs_root_id, "dev", FS_TYPE_DIRECTORY);
+    }
+    if (devfs_init("dev")) {
+        vfs_mount("/dev", &devfs_ops, DEVFS_ROOT_ID);
+    }
+}
+
+int vfs_mount(const char* path, const vfs_ops_t* ops, uint32_t root_id) {
+    uint32_t tag = VFS_TAG(root_id);
+    if (mount_count >= VFS_MAX_MOUNTS || strlen(path) >= VFS_MAX_PATH) return 0;
+    if (fs_types[tag] && fs_types[tag] != ops) return 0;  // Tag owned by another type
+    if (!ops->get_node(root_id)) return 0;
+
+    uint32_t covered = 0;
+    if (mount_count == 0) {
+        if (strcmp(path, "/") != 0) return 0;
+    } else {
+        fs_node_t* dir = vfs_find_node(path, vfs_root_id);
+        if (!dir || dir->type != FS_TYPE_DIRECTORY) return 0;
+        if (mount_of_root(dir->id)) return 0;  // Already a mount point
+        covered = dir->id;
+    }
+
+    fs_types[tag] = ops;
+    vfs_mount_t* m = &mounts[mount_count++];
+    m->ops = ops;
+    m->root_id = root_id;
+    m->covered_id = covered;
+    if (covered) covered_bits |= 1u << (covered % 32);
+    strcpy(m->path, path);
+    if (covered == 0) vfs_root_id = root_id;
+    return 1;
+}
+
+const vfs_mount_t* vfs_get_mount(uint32_t i) {
+    return i < mount_count ? &mounts[i] : 0;
+}
+
+uint32_t vfs_flags(uint32_t id) {
+    const vfs_ops_t* ops = ops_of(id);
+    return ops ? ops->flags : 0;
+}
+
+uint32_t vfs_block_size(uint32_t id) {
+    const vfs_ops_t* ops = ops_of(id);
+    return ops ? ops->block_size : 0;
+}
+
+fs_node_t* vfs_get_node(uint32_t id) {
+    const vfs_ops_t* ops = ops_of(id);
+    return ops ? ops->get_node(id) : 0;
+}
+
+uint32_t vfs_lookup(uint32_t dir_id, const char* name, uint32_t len) {
+    const vfs_ops_t* ops = ops_of(dir_id);
+    if (!ops) return 0;
+    uint32_t id = ops->lookup(dir_id, name, len);
+    return id ? cross_mount(id) : 0;
+}
+
+fs_node_t* vfs_find_node(const char* path, uint32_t start_id) {
+    if (!path) return 0;
+
+    uint32_t id = start_id;
+    if (path[0] == '/') {
+        id = vfs_root_id;
+        path++;
+    }
+
+    while (*path != '\0') {
+        uint32_t len = 0;
+        while (path[len] != '/' && path[len] != '\0') {
+            len++;
+        }
+
+        if (len == 2 && path[0] == '.' && path[1] == '.') {
+            vfs_mount_t* m = mount_of_root(id);
+            if (m && m->covered_id) id = m->covered_id;  // Leave the mounted filesystem
+            fs_node_t* cur = vfs_get_node(id);
+            if (cur) id = cur->parent_id;
+        } else if (len > 0 && !(len == 1 && path[0] == '.')) {
+            id = vfs_lookup(id, path, len);
+            if (id == 0) return 0;
+        }
+
+        path += len;
+        if (*path == '/') path++;
+    }
+
+    return vfs_get_node(id);
+}
+
+int vfs_create(uint32_t parent_id, const char* name, uint8_t type) {
+    const vfs_ops_t* ops = ops_of(parent_id);
+    return ops ? ops->create(parent_id, name, type) : 0;
+}
+
+int vfs_delete(uint32_t id) {
+    const vfs_ops_t* ops = ops_of(id);
+    if (!ops || mount_of_root(id)) return 0;
+
+    if (!ops->remove(id)) return 0;
+    if (!(ops->flags & VFS_CACHED)) pcache_forget(id);
+    syscall_forget_node(id);  // The ID may be reused: open fds must not follow it
+    return 1;
+}
+
+int vfs_readdir(uint32_t dir_id, uint32_t* cursor, fs_dirent_t* out) {
+    const vfs_ops_t* ops = ops_of(dir_id);
+    if (!ops || !ops->readdir(dir_id, cursor, out)) return 0;
+    out->id = cross_mount(out->id);
+    return 1;
+}
+
+int vfs_read(fs_node_t* node, uint32_t offset, void* buf, uint32_t count) {
+    const vfs_ops_t* ops = node ? ops_of(node->id) : 0;
+    if (!ops) return -1;
+    if (ops->flags & VFS_CACHED) return pcache_read(node, offset, buf, count);
+    return ops->read(node, offset, buf, count);
+}
+
+int vfs_read_uncached(fs_node_t* node, uint32_t offset, void* buf, uint32_t count) {
+    const vfs_ops_t* ops = node ? ops_of(node->id) : 0;
+    return ops ? ops->read(node, offset, buf, count) : -1;
+}
+
+int vfs_write(const fs_node_t* node, uint32_t offset, const void* buf, uint32_t count) {
+    const vfs_ops_t* ops = node ? ops_of(node->id) : 0;
+    if (!ops) return -1;
+
+    uint32_t id = node->id;
+    int done = ops->write(node, offset, buf, count);
+    if (done > 0 && !(ops->flags & VFS_CACHED)) {
+        pcache_update(id, offset, buf, done);  // Pages cached for mmap
+    }
+    return done;
+}
+
+int vfs_copy_range(const fs_node_t* src, uint32_t src_off, const fs_node_t* dst, uint32_t dst_off, uint32_t count) {
+    const vfs_ops_t* src_ops = src ? ops_of(src->id) : 0;
+    const vfs_ops_t* dst_ops = dst ? ops_of(dst->id) : 0;
+    if (!src_ops || !dst_ops) return -1;
+    if (src_ops == dst_ops && src_ops->copy_range) {
+        return src_ops->copy_range(src, src_off, dst, dst_off, count);
+    }
+
+    fs_node_t s = *src;
+    fs_node_t d = *dst;
+    if (s.type != FS_TYPE_FILE || d.type != FS_TYPE_FILE) return -1;
+    if (!copy_buf) {
+        copy_buf = (uint8_t*)pmm_alloc_pages(VFS_COPY_PAGES);
+        if (!copy_buf) return -1;
+    }
+
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t chunk = count - done;
+        if (chunk > VFS_COPY_PAGES * PAGE_SIZE) chunk = VFS_COPY_PAGES * PAGE_SIZE;
+        int got = vfs_read_uncached(&s, src_off + done, copy_buf, chunk);
+        if (got < 0) return done > 0 ? (int)done : -1;
+        if (got == 0) break;
+
+        int put = vfs_write(&d, dst_off + done, copy_buf, got);
+        if (put <= 0) break;
+        done += put;
+        if (put < got) break;
+    }
+    return done;
+}
+
+int vfs_sync(uint32_t id, int datasync) {
+    const vfs_ops_t* ops = ops_of(id);
+    if (!ops) return -1;
+    return ops->sync ? ops->sync(id, datasync) : 0;
+}
+
+int vfs_clone(uint32_t src_id, uint32_t parent_id, const char* name) {
+    const vfs_ops_t* ops = ops_of(src_id);
+    if (!ops || ops != ops_of(parent_id) || !ops->clone) return 0;
+    return ops->clone(src_id, parent_id, name);
+}
@@ -0,0 +1,880 @@
+/**
+ * tools/mkpunixfs.c - Host-side PUNIX filesystem tool
+ * Builds a disk image from a host directory tree, checks (and repairs)
+ * an existing image and prints layout statistics. The on-disk structures
+ * come from include/fs.h, the same header the kernel uses.
+ *
+ * Build: gcc -O2 -o mkpunixfs tools/mkpunixfs.c
+ * Usage: mkpunixfs build <image> <dir> [size-MB]
+ *        mkpunixfs check <image> [-r]
+ *        mkpunixfs stat  <image>
+ *
+ * build keeps the bootloader (LBA 0) and the kernel area (FS_KERNEL_START)
+ * of an existing image, so it can run after build.sh has written boot.bin
+ * and kernel.bin.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TYPES_H  // The host's <stdint.h> replaces the kernel's types.h
+#include "../include/fs.h"
+
+#define SECTOR_SIZE     FS_SECTOR_SIZE
+#define MAX_DIR_ENTRIES 1000000
+
+// --- Image Access ---
+
+static uint8_t* img;
+static uint32_t img_sectors;
+static superblock_t* sb;
+
+static uint8_t* sector(uint32_t lba) {
+    return img + (size_t)lba * SECTOR_SIZE;
+}
+
+static fs_node_t* inode(uint32_t id) {
+    return (fs_node_t*)sector(sb->inode_table_start + id / FS_INODES_PER_SECTOR) +
+           (id % FS_INODES_PER_SECTOR);
+}
+
+static int bit_test(uint32_t start, uint32_t index) {
+    return (sector(start)[index / 8] >> (index % 8)) & 1;
+}
+
+static void bit_set(uint32_t start, uint32_t index) {
+    sector(start)[index / 8] |= 1 << (index % 8);
+}
+
+static int map_test(const uint8_t* map, uint32_t index) {
+    return (map[index / 8] >> (index % 8)) & 1;
+}
+
+static void map_set(uint8_t* map, uint32_t index) {
+    map[index / 8] |= 1 << (index % 8);
+}
+
+/**
+ * @brief Maps the image file into memory, creating or growing it
+ * @param size_mb New size in MB, or 0 to keep the current size
+ * @param writable 0 = changes stay in memory (copy-on-write mapping)
+ * @return 0 on success, -1 on failure
+ */
+static int open_image(const char* path, uint32_t size_mb, int create, int writable) {
+    int fd = open(path, create ? O_RDWR | O_CREAT : (writable ? O_RDWR : O_RDONLY), 0644);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    off_t size = st.st_size;
+    if (size_mb) {
+        size = (off_t)size_mb * 1024 * 1024;
+        if (ftruncate(fd, size) != 0) {
+            perror("ftruncate");
+            close(fd);
+            return -1;
+        }
+    }
+    if (size < (off_t)(FS_LAYOUT_START + 64) * SECTOR_SIZE) {
+        fprintf(stderr, "%s: image too small (give a size in MB)\n", path);
+        close(fd);
+        return -1;
+    }
+
+    img_sectors = size / SECTOR_SIZE;
+    img = mmap(0, (size_t)img_sectors * SECTOR_SIZE, PROT_READ | PROT_WRITE,
+               writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (img == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    sb = (superblock_t*)sector(FS_SUPERBLOCK_SECTOR);
+    return 0;
+}
+
+static void close_image() {
+    msync(img, (size_t)img_sectors * SECTOR_SIZE, MS_SYNC);
+    munmap(img, (size_t)img_sectors * SECTOR_SIZE);
+}
+
+// --- Formatting (mirrors format_layout() in src/fs.c) ---
+
+static uint32_t next_id;
+static uint32_t next_lba;
+
+static void format() {
+    uint32_t total = img_sectors;
+    uint32_t max_nodes = total / FS_SECTORS_PER_INODE;
+    max_nodes -= max_nodes % FS_INODES_PER_SECTOR;
+
+    memset(sb, 0, sizeof(superblock_t));
+    sb->magic = FS_MAGIC;
+    sb->version = FS_VERSION;
+    sb->root_id = FS_ROOT_ID;
+    sb->max_nodes = max_nodes;
+    sb->total_sectors = total;
+    sb->inode_bitmap_start = FS_LAYOUT_START;
+    sb->inode_bitmap_sectors = (max_nodes + FS_BITS_PER_SECTOR - 1) / FS_BITS_PER_SECTOR;
+    sb->block_bitmap_start = sb->inode_bitmap_start + sb->inode_bitmap_sectors;
+    sb->block_bitmap_sectors = (total + FS_BITS_PER_SECTOR - 1) / FS_BITS_PER_SECTOR;
+    sb->inode_table_start = sb->block_bitmap_start + sb->block_bitmap_sectors;
+    sb->inode_table_sectors = max_nodes / FS_INODES_PER_SECTOR;
+    sb->data_start = sb->inode_table_start + sb->inode_table_sectors;
+
+    // Empty journal slots, bitmaps and inode table; the kernel area between
+    // them is left alone
+    memset(sector(FS_JOURNAL_START), 0, (size_t)(FS_KERNEL_START - FS_JOURNAL_START) * SECTOR_SIZE);
+    memset(sector(FS_LAYOUT_START), 0, (size_t)(sb->data_start - FS_LAYOUT_START) * SECTOR_SIZE);
+
+    // Inode 0 is "no node"; everything before the data region is in use
+    bit_set(sb->inode_bitmap_start, 0);
+    for (uint32_t i = 0; i < sb->data_start; i++) {
+        bit_set(sb->block_bitmap_start, i);
+    }
+    for (uint32_t i = max_nodes; i < sb->inode_bitmap_sectors * FS_BITS_PER_SECTOR; i++) {
+        bit_set(sb->inode_bitmap_start, i);
+    }
+    for (uint32_t i = total; i < sb->block_bitmap_sectors * FS_BITS_PER_SECTOR; i++) {
+        bit_set(sb->block_bitmap_start, i);
+    }
+
+    next_id = FS_ROOT_ID;
+    next_lba = sb->data_start;
+}
+
+static uint32_t alloc_inode() {
+    if (next_id >= sb->max_nodes) {
+        fprintf(stderr, "mkpunixfs: out of inodes\n");
+        exit(1);
+    }
+    bit_set(sb->inode_bitmap_start, next_id);
+    sb->total_nodes++;
+    return next_id++;
+}
+
+static uint32_t alloc_block(fs_node_t* node) {
+    if (next_lba >= sb->total_sectors) {
+        fprintf(stderr, "mkpunixfs: image full\n");
+        exit(1);
+    }
+    bit_set(sb->block_bitmap_start, next_lba);
+    memset(sector(next_lba), 0, SECTOR_SIZE);
+    node->blocks++;
+    return next_lba++;
+}
+
+static uint32_t map_slot(fs_node_t* node, uint32_t table, uint32_t index) {
+    uint32_t* ptrs = (uint32_t*)sector(table);
+    if (ptrs[index] == 0) {
+        uint32_t lba = alloc_block(node);
+        ptrs[index] = lba;
+    }
+    return ptrs[index];
+}
+
+/**
+ * @brief Maps (allocating) block b of a node, as bmap() does
+ */
+static uint32_t bmap_alloc(fs_node_t* node, uint32_t b) {
+    if (b < FS_DIRECT_BLOCKS) {
+        if (node->direct[b] == 0) node->direct[b] = alloc_block(node);
+        return node->direct[b];
+    }
+    b -= FS_DIRECT_BLOCKS;
+
+    if (b < FS_PTRS_PER_BLOCK) {
+        if (node->indirect == 0) node->indirect = alloc_block(node);
+        return map_slot(node, node->indirect, b);
+    }
+    b -= FS_PTRS_PER_BLOCK;
+
+    if (b < FS_PTRS_PER_BLOCK * FS_PTRS_PER_BLOCK) {
+        if (node->double_indirect == 0) node->double_indirect = alloc_block(node);
+        uint32_t table = map_slot(node, node->double_indirect, b / FS_PTRS_PER_BLOCK);
+        return map_slot(node, table, b % FS_PTRS_PER_BLOCK);
+    }
+
+    fprintf(stderr, "mkpunixfs: file too large\n");
+    exit(1);
+}
+
+/**
+ * @brief Looks up block b of a node without allocating
+ * @return LBA, or 0 for a hole / out of range pointer
+ */
+static uint32_t bmap(fs_node_t* node, uint32_t b) {
+    uint32_t lba;
+    if (b < FS_DIRECT_BLOCKS) {
+        lba = node->direct[b];
+    } else if ((b -= FS_DIRECT_BLOCKS) < FS_PTRS_PER_BLOCK) {
+        if (node->indirect == 0 || node->indirect >= img_sectors) return 0;
+        lba = ((uint32_t*)sector(node->indirect))[b];
+    } else if ((b -= FS_PTRS_PER_BLOCK) < FS_PTRS_PER_BLOCK * FS_PTRS_PER_BLOCK) {
+        if (node->double_indirect == 0 || node->double_indirect >= img_sectors) return 0;
+        uint32_t table = ((uint32_t*)sector(node->double_indirect))[b / FS_PTRS_PER_BLOCK];
+        if (table == 0 || table >= img_sectors) return 0;
+        lba = ((uint32_t*)sector(table))[b % FS_PTRS_PER_BLOCK];
+    } else {
+        return 0;
+    }
+    return lba < img_sectors ? lba : 0;
+}
+
+// --- Directories ---
+
+typedef struct {
+    uint32_t id;
+    uint32_t hash;
+    uint8_t  type;
+    uint8_t  len;
+    char     name[FS_MAX_NAME];
+} entry_t;
+
+static int entry_cmp(const void* a, const void* b) {
+    uint32_t x = ((const entry_t*)a)->hash;
+    uint32_t y = ((const entry_t*)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Packs entries into one directory block
+ */
+static void pack_block(uint8_t* block, entry_t* e, uint32_t n) {
+    uint32_t off = 0;
+    memset(block, 0, SECTOR_SIZE);
+    ((fs_disk_dirent_t*)block)->rec_len = SECTOR_SIZE;
+
+    for (uint32_t i = 0; i < n; i++) {
+        fs_disk_dirent_t* de = (fs_disk_dirent_t*)(block + off);
+        uint32_t size = FS_DIRENT_SIZE(e[i].len);
+        de->id = e[i].id;
+        de->type = e[i].type;
+        de->name_len = e[i].len;
+        memcpy(de->name, e[i].name, e[i].len);
+        de->rec_len = i + 1 < n ? size : SECTOR_SIZE - off;
+        off += size;
+    }
+}
+
+static void index_init(uint8_t* block, uint8_t levels) {
+    memset(block, 0, SECTOR_SIZE);
+    ((fs_disk_dirent_t*)block)->rec_len = SECTOR_SIZE;
+    fs_dx_header_t* hdr = (fs_dx_header_t*)(block + FS_DIRENT_HEADER);
+    hdr->limit = FS_DX_LIMIT;
+    hdr->levels = levels;
+}
+
+static fs_dx_header_t* index_header(uint8_t* block) {
+    return (fs_dx_header_t*)(block + FS_DIRENT_HEADER);
+}
+
+static fs_dx_entry_t* index_entries(uint8_t* block) {
+    return (fs_dx_entry_t*)(block + FS_DIRENT_HEADER + sizeof(fs_dx_header_t));
+}
+
+/**
+ * @brief Writes a directory's entries, building a hash index when they
+ * do not fit in one block. Leaves are packed in hash order and the
+ * index is built bottom-up; the kernel splits them as they fill.
+ */
+static void write_directory(fs_node_t* dir, entry_t* e, uint32_t n) {
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < n; i++) bytes += FS_DIRENT_SIZE(e[i].len);
+
+    dir->child_count = n;
+    if (n == 0) return;
+    if (bytes <= SECTOR_SIZE) {
+        pack_block(sector(bmap_alloc(dir, 0)), e, n);
+        dir->size = SECTOR_SIZE;
+        return;
+    }
+
+    for (uint32_t i = 0; i < n; i++) e[i].hash = fs_name_hash(e[i].name, e[i].len);
+    qsort(e, n, sizeof(entry_t), entry_cmp);
+
+    // Leaf boundaries: fill each block, never splitting a run of equal hashes
+    fs_dx_entry_t* ptrs = calloc(n + 1, sizeof(fs_dx_entry_t));
+    uint32_t count = 0;
+    uint32_t block_no = 1;  // Block 0 is the index root
+    uint32_t start = 0;
+    while (start < n) {
+        uint32_t end = start;
+        uint32_t used = 0;
+        while (end < n && used + FS_DIRENT_SIZE(e[end].len) <= SECTOR_SIZE) {
+            used += FS_DIRENT_SIZE(e[end].len);
+            end++;
+        }
+        if (end < n) {
+            uint32_t cut = end;
+            while (cut > start && e[cut].hash == e[cut - 1].hash) cut--;
+            if (cut == start) {
+                fprintf(stderr, "mkpunixfs: too many names share one hash\n");
+                exit(1);
+            }
+            end = cut;
+        }
+        pack_block(sector(bmap_alloc(dir, block_no)), e + start, end - start);
+        ptrs[count].hash = count == 0 ? 0 : e[start].hash;
+        ptrs[count].block = block_no++;
+        count++;
+        start = end;
+    }
+
+    // Interior levels until the pointers fit in the root
+    uint8_t levels = 1;
+    while (count > FS_DX_LIMIT) {
+        if (++levels > FS_DX_MAX_LEVELS) {
+            fprintf(stderr, "mkpunixfs: directory too large\n");
+            exit(1);
+        }
+        uint32_t out = 0;
+        for (uint32_t i = 0; i < count; i += FS_DX_LIMIT) {
+            uint32_t take = count - i < FS_DX_LIMIT ? count - i : FS_DX_LIMIT;
+            uint8_t* block = sector(bmap_alloc(dir, block_no));
+            index_init(block, 0);
+            memcpy(index_entries(block), ptrs + i, take * sizeof(fs_dx_entry_t));
+            index_header(block)->count = take;
+            ptrs[out].hash = ptrs[i].hash;
+            ptrs[out].block = block_no++;
+            out++;
+        }
+        count = out;
+    }
+
+    uint8_t* root = sector(bmap_alloc(dir, 0));
+    index_init(root, levels);
+    memcpy(index_entries(root), ptrs, count * sizeof(fs_dx_entry_t));
+    index_header(root)->count = count;
+    free(ptrs);
+
+    dir->size = block_no * SECTOR_SIZE;
+    dir->flags |= FS_FLAG_INDEXED;
+}
+
+// --- build ---
+
+static uint32_t files_added, dirs_added;
+
+static void add_file(fs_node_t* node, const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return;
+    }
+
+    uint8_t buf[SECTOR_SIZE];
+    size_t got;
+    uint32_t b = 0;
+    while ((got = fread(buf, 1, SECTOR_SIZE, f)) > 0) {
+        uint32_t lba = bmap_alloc(node, b++);
+        memcpy(sector(lba), buf, got);
+        node->size += got;
+    }
+    fclose(f);
+}
+
+/**
+ * @brief Copies a host directory's contents into directory id
+ * Children get their inodes (and file data) before the parent's entry
+ * blocks are written, so each directory's blocks stay together.
+ */
+static void add_tree(uint32_t id, const char* path) {
+    DIR* d = opendir(path);
+    if (!d) {
+        perror(path);
+        return;
+    }
+
+    entry_t* e = malloc(sizeof(entry_t) * MAX_DIR_ENTRIES);
+    uint32_t n = 0;
+    struct dirent* ent;
+    char child[4096];
+
+    while ((ent = readdir(d)) != 0 && n < MAX_DIR_ENTRIES) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+
+        size_t len = strlen(ent->d_name);
+        snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+        struct stat st;
+        if (len >= FS_MAX_NAME || stat(child, &st) != 0 ||
+            !(S_ISREG(st.st_mode) || S_ISDIR(st.st_mode))) {
+            fprintf(stderr, "mkpunixfs: skipping %s\n", child);
+            continue;
+        }
+
+        uint32_t child_id = alloc_inode();
+        fs_node_t* node = inode(child_id);
+        memset(node, 0, sizeof(fs_node_t));
+        node->id = child_id;
+        node->parent_id = id;
+        node->type = S_ISDIR(st.st_mode) ? FS_TYPE_DIRECTORY : FS_TYPE_FILE;
+        memcpy(node->name, ent->d_name, len);
+
+        if (node->type == FS_TYPE_DIRECTORY) {
+            add_tree(child_id, child);
+            dirs_added++;
+        } else {
+            add_file(node, child);
+            files_added++;
+        }
+
+        e[n].id = child_id;
+        e[n].type = node->type;
+        e[n].len = len;
+        memcpy(e[n].name, ent->d_name, len);
+        n++;
+    }
+    closedir(d);
+
+    write_directory(inode(id), e, n);
+    free(e);
+}
+
+static int cmd_build(const char* image, const char* dir, uint32_t size_mb) {
+    if (open_image(image, size_mb, 1, 1) != 0) return 2;
+    format();
+
+    uint32_t root_id = alloc_inode();
+    fs_node_t* root = inode(root_id);
+    root->id = FS_ROOT_ID;
+    root->parent_id = FS_ROOT_ID;
+    root->type = FS_TYPE_DIRECTORY;
+    add_tree(root_id, dir);
+
+    sb->next_free_id = next_id;
+    sb->next_free_lba = next_lba;
+    sb->used_sectors = next_lba;
+    close_image();
+
+    printf("%s: %u directories, %u files, %u of %u sectors used\n",
+           image, dirs_added, files_added, next_lba, img_sectors);
+    return 0;
+}
+
+// --- check / stat ---
+
+typedef struct {
+    uint32_t errors;
+    uint32_t fixed;
+    uint32_t files;
+    uint32_t dirs;
+    uint32_t indexed_dirs;
+    uint32_t largest_dir;
+    uint64_t file_bytes;
+    uint32_t fragmented;      // Files whose data is not one contiguous run
+    uint32_t nodes;
+    uint32_t blocks;
+} report_t;
+
+static report_t rep;
+static int repair;
+static uint8_t* seen_inodes;
+static uint8_t* claims;        // Owners of each sector (saturating)
+
+static void problem(const char* what, uint32_t id) {
+    printf("  node %u: %s%s\n", id, what, repair ? " (fixed)" : "");
+    rep.errors++;
+    if (repair) rep.fixed++;
+}
+
+/**
+ * @brief Extra owners of a shared block, from the count sectors of inode 0
+ */
+static uint32_t block_refs(uint32_t lba) {
+    fs_node_t* refs = inode(FS_REFS_ID);
+    if (sb->version < 7 || refs->blocks == 0) return 0;
+    uint32_t count_lba = bmap(refs, lba / SECTOR_SIZE);
+    return count_lba ? sector(count_lba)[lba % SECTOR_SIZE] : 0;
+}
+
+/**
+ * @brief Claims one block for a node
+ * @return 0 if it is out of range or already owned by something that
+ * does not share it
+ */
+static int claim(uint32_t lba, uint32_t id) {
+    if (lba < sb->data_start || lba >= sb->total_sectors) {
+        problem("block pointer out of range", id);
+        return 0;
+    }
+    if (claims[lba] && claims[lba] > block_refs(lba)) {
+        problem("block shared with another node", id);
+        return 0;
+    }
+    if (claims[lba] == 0) rep.blocks++;
+    if (claims[lba] < 255) claims[lba]++;
+    return 1;
+}
+
+static uint32_t claim_table(uint32_t lba, uint32_t id, int depth) {
+    uint32_t count = 1;
+    if (!claim(lba, id)) return 0;
+
+    uint32_t* ptrs = (uint32_t*)sector(lba);
+    for (uint32_t i = 0; i < FS_PTRS_PER_BLOCK; i++) {
+        if (ptrs[i] == 0) continue;
+        if (depth > 1) {
+            count += claim_table(ptrs[i], id, depth - 1);
+        } else if (claim(ptrs[i], id)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Claims all of a node's blocks and checks its block count
+ */
+static void check_blocks(fs_node_t* node) {
+    uint32_t count = 0;
+    uint32_t runs = 0;
+    uint32_t prev = 0;
+
+    for (uint32_t b = 0; b < FS_DIRECT_BLOCKS; b++) {
+        uint32_t lba = node->direct[b];
+        if (lba == 0) continue;
+        if (claim(lba, node->id)) count++;
+        if (lba != prev + 1) runs++;
+        prev = lba;
+    }
+    if (node->indirect) count += claim_table(node->indirect, node->id, 1);
+    if (node->double_indirect) count += claim_table(node->double_indirect, node->id, 2);
+
+    if (node->type == FS_TYPE_FILE && node->id != FS_REFS_ID) {
+        uint32_t data = (node->size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        for (uint32_t b = FS_DIRECT_BLOCKS; b < data; b++) {
+            uint32_t lba = bmap(node, b);
+            if (lba && lba != prev + 1) runs++;
+            if (lba) prev = lba;
+        }
+        if (runs > 1) rep.fragmented++;
+    }
+
+    if (count != node->blocks) {
+        problem("block count does not match its pointers", node->id);
+        if (repair) node->blocks = count;
+    }
+}
+
+/**
+ * @brief Follows a directory's hash index to the leaf covering a hash
+ * @return Directory-relative block, or -1 if the index is damaged
+ */
+static int64_t index_leaf(fs_node_t* dir, uint32_t hash) {
+    uint32_t lba = bmap(dir, 0);
+    if (!lba) return -1;
+    uint32_t levels = index_header(sector(lba))->levels;
+    if (levels == 0 || levels > FS_DX_MAX_LEVELS) return -1;
+
+    uint32_t block_no = 0;
+    for (uint32_t level = 0; level < levels; level++) {
+        lba = bmap(dir, block_no);
+        if (!lba) return -1;
+        fs_dx_header_t* hdr = index_header(sector(lba));
+        fs_dx_entry_t* e = index_entries(sector(lba));
+        if (hdr->count == 0 || hdr->count > FS_DX_LIMIT) return -1;
+
+        uint32_t lo = 0, hi = hdr->count;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            if (e[mid].hash <= hash) lo = mid; else hi = mid;
+        }
+        block_no = e[lo].block;
+    }
+    return block_no;
+}
+
+static uint32_t* queue;
+static uint32_t queue_len;
+
+/**
+ * @brief Checks every entry of one directory and queues its subdirectories
+ */
+static void check_directory(fs_node_t* dir) {
+    uint32_t entries = 0;
+    uint32_t blocks = dir->size / SECTOR_SIZE;
+
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t lba = bmap(dir, b);
+        if (!lba) continue;
+        uint8_t* block = sector(lba);
+
+        uint32_t off = 0;
+        while (off < SECTOR_SIZE) {
+            fs_disk_dirent_t* de = (fs_disk_dirent_t*)(block + off);
+            if (de->rec_len < FS_DIRENT_HEADER || (de->rec_len & 3) || off + de->rec_len > SECTOR_SIZE ||
+                de->name_len >= FS_MAX_NAME || (de->id && FS_DIRENT_SIZE(de->name_len) > de->rec_len)) {
+                problem("corrupt directory block", dir->id);
+                if (repair) {
+                    memset(block + off, 0, SECTOR_SIZE - off);
+                    de->rec_len = SECTOR_SIZE - off;
+                }
+                break;
+            }
+
+            uint32_t id = de->id;
+            if (id != 0) {
+                fs_node_t* child = id < sb->max_nodes ? inode(id) : 0;
+                const char* bad = 0;
+                if (!child || !bit_test(sb->inode_bitmap_start, id) || child->id != id) {
+                    bad = "entry points at a free or invalid node";
+                } else if (map_test(seen_inodes, id)) {
+                    bad = "node linked from more than one entry";
+                } else if ((dir->flags & FS_FLAG_INDEXED) &&
+                           index_leaf(dir, fs_name_hash(de->name, de->name_len)) != b) {
+                    bad = "entry not reachable through the hash index";
+                }
+
+                if (bad) {
+                    problem(bad, dir->id);
+                    if (repair) de->id = 0;
+                } else {
+                    map_set(seen_inodes, id);
+                    entries++;
+                    if (child->parent_id != dir->id) {
+                        problem("parent_id does not match its directory", id);
+                        if (repair) child->parent_id = dir->id;
+                    }
+                    if (child->type != de->type) {
+                        problem("type differs from its directory entry", id);
+                        if (repair) de->type = child->type;
+                    }
+                    if (strlen(child->name) != de->name_len ||
+                        memcmp(child->name, de->name, de->name_len) != 0) {
+                        problem("name differs from its directory entry", id);
+                        if (repair) {
+                            memset(child->name, 0, FS_MAX_NAME);
+                            memcpy(child->name, de->name, de->name_len);
+                        }
+                    }
+                    queue[queue_len++] = id;
+                }
+            }
+            off += de->rec_len;
+        }
+    }
+
+    if (entries != dir->child_count) {
+        problem("child_count does not match its entries", dir->id);
+        if (repair) dir->child_count = entries;
+    }
+    if (entries > rep.largest_dir) rep.largest_dir = entries;
+}
+
+/**
+ * @brief Walks the whole tree from the root and compares the result
+ * with the bitmaps and superblock counters
+ */
+static void walk() {
+    memset(&rep, 0, sizeof(rep));
+    seen_inodes = calloc(sb->max_nodes / 8 + 1, 1);
+    claims = calloc(sb->total_sectors, 1);
+    queue = malloc(sizeof(uint32_t) * sb->max_nodes);
+    queue_len = 0;
+
+    for (uint32_t i = 0; i < sb->data_start; i++) claims[i] = 1;
+    map_set(seen_inodes, FS_REFS_ID);
+    check_blocks(inode(FS_REFS_ID));  // Owns the count sectors
+    map_set(seen_inodes, FS_ROOT_ID);
+    queue[queue_len++] = FS_ROOT_ID;
+
+    for (uint32_t head = 0; head < queue_len; head++) {
+        fs_node_t* node = inode(queue[head]);
+        rep.nodes++;
+        check_blocks(node);
+        if (node->type == FS_TYPE_DIRECTORY) {
+            rep.dirs++;
+            if (node->flags & FS_FLAG_INDEXED) rep.indexed_dirs++;
+            check_directory(node);
+        } else {
+            rep.files++;
+            rep.file_bytes += node->size;
+        }
+    }
+
+    // Anything marked in use but unreachable is leaked
+    uint32_t leaked_nodes = 0, leaked_blocks = 0, lost_blocks = 0, bad_refs = 0;
+    for (uint32_t i = 0; i < sb->max_nodes; i++) {
+        if (bit_test(sb->inode_bitmap_start, i) && !map_test(seen_inodes, i)) leaked_nodes++;
+    }
+    for (uint32_t i = 0; i < sb->total_sectors; i++) {
+        int on_disk = bit_test(sb->block_bitmap_start, i);
+        int in_use = claims[i] != 0;
+        if (on_disk && !in_use) leaked_blocks++;
+        if (!on_disk && in_use) lost_blocks++;
+        if (in_use && i >= sb->data_start && claims[i] < 255 && claims[i] != 1 + block_refs(i)) bad_refs++;
+    }
+    if (leaked_nodes) {
+        printf("  %u nodes allocated but unreachable%s\n", leaked_nodes, repair ? " (freed)" : "");
+        rep.errors++;
+    }
+    if (leaked_blocks || lost_blocks) {
+        printf("  block bitmap: %u leaked, %u in use but marked free%s\n",
+               leaked_blocks, lost_blocks, repair ? " (fixed)" : "");
+        rep.errors++;
+    }
+    if (bad_refs) {
+        printf("  %u shared blocks with a wrong reference count\n", bad_refs);
+        rep.errors++;
+    }
+    if (sb->total_nodes != rep.nodes || sb->used_sectors != rep.blocks + sb->data_start) {
+        printf("  superblock counters: %u nodes / %u sectors, expected %u / %u%s\n",
+               sb->total_nodes, sb->used_sectors, rep.nodes, rep.blocks + sb->data_start,
+               repair ? " (fixed)" : "");
+        rep.errors++;
+    }
+
+    if (repair && (leaked_nodes || leaked_blocks || lost_blocks)) {
+        for (uint32_t i = 0; i < sb->max_nodes; i++) {
+            uint8_t* byte = &sector(sb->inode_bitmap_start)[i / 8];
+            if (map_test(seen_inodes, i)) *byte |= 1 << (i % 8); else *byte &= ~(1 << (i % 8));
+        }
+        for (uint32_t i = 0; i < sb->total_sectors; i++) {
+            uint8_t* byte = &sector(sb->block_bitmap_start)[i / 8];
+            if (claims[i]) *byte |= 1 << (i % 8); else *byte &= ~(1 << (i % 8));
+        }
+    }
+    if (repair) {
+        sb->total_nodes = rep.nodes;
+        sb->used_sectors = rep.blocks + sb->data_start;
+    }
+
+    free(seen_inodes);
+    free(claims);
+    free(queue);
+}
+
+static uint32_t journal_checksum(fs_journal_desc_t* desc, uint8_t* data) {
+    uint32_t sum = 2166136261u ^ desc->sequence;
+    for (uint32_t i = 0; i < desc->count; i++) {
+        uint32_t* words = (uint32_t*)(data + i * SECTOR_SIZE);
+        sum = (sum ^ desc->lba[i]) * 16777619u;
+        for (uint32_t w = 0; w < SECTOR_SIZE / 4; w++) {
+            sum = (sum ^ words[w]) * 16777619u;
+        }
+    }
+    return sum;
+}
+
+/**
+ * @brief Finds the newest committed journal group, as fs_init() would
+ * @return Its descriptor, or 0 if neither slot is valid
+ */
+static fs_journal_desc_t* journal_newest() {
+    fs_journal_desc_t* best = 0;
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        uint32_t lba = FS_JOURNAL_START + slot * FS_JOURNAL_SLOT_SECTORS;
+        fs_journal_desc_t* desc = (fs_journal_desc_t*)sector(lba);
+        if (desc->magic != FS_JOURNAL_MAGIC || desc->count == 0 ||
+            desc->count > FS_JOURNAL_MAX_BLOCKS || (desc->sequence & 1) != slot ||
+            journal_checksum(desc, sector(lba + 1)) != desc->checksum) {
+            continue;
+        }
+        if (!best || desc->sequence > best->sequence) best = desc;
+    }
+    return best;
+}
+
+/**
+ * @brief Opens an image and brings it to the state the kernel would see
+ * after replaying its journal (in memory only unless writable)
+ */
+static int open_existing(const char* image, int writable) {
+    if (open_image(image, 0, 0, writable) != 0) return 2;
+    if (sb->magic != FS_MAGIC || sb->version < FS_MIN_VERSION || sb->version > FS_VERSION ||
+        sb->data_start >= img_sectors || sb->total_sectors > img_sectors) {
+        fprintf(stderr, "%s: no supported PUNIX filesystem\n", image);
+        return 2;
+    }
+
+    fs_journal_desc_t* desc = sb->version >= 6 ? journal_newest() : 0;
+    if (desc) {
+        uint8_t* data = (uint8_t*)desc + SECTOR_SIZE;
+        for (uint32_t i = 0; i < desc->count; i++) {
+            if (desc->lba[i] < img_sectors) {
+                memcpy(sector(desc->lba[i]), data + i * SECTOR_SIZE, SECTOR_SIZE);
+            }
+        }
+        // A replayed group must not be replayed again over later repairs
+        memset(sector(FS_JOURNAL_START), 0, SECTOR_SIZE);
+        memset(sector(FS_JOURNAL_START + FS_JOURNAL_SLOT_SECTORS), 0, SECTOR_SIZE);
+    }
+    return 0;
+}
+
+static int cmd_check(const char* image, int fix) {
+    int err = open_existing(image, fix);
+    if (err) return err;
+    repair = fix;
+
+    walk();
+    close_image();
+
+    if (rep.errors == 0) {
+        printf("%s: clean, %u nodes, %u data sectors\n", image, rep.nodes, rep.blocks);
+        return 0;
+    }
+    printf("%s: %u problems%s\n", image, rep.errors, repair ? " repaired" : "");
+    return 1;
+}
+
+static int cmd_stat(const char* image) {
+    int err = open_existing(image, 0);
+    if (err) return err;
+    repair = 0;
+    walk();
+
+    printf("PUNIX filesystem v%u, %u sectors (%u MB)\n", sb->version, sb->total_sectors,
+           sb->total_sectors / 2048);
+    printf("  superblock      LBA %u\n", FS_SUPERBLOCK_SECTOR);
+    printf("  journal         LBA %u-%u (%u sectors per slot)\n", FS_JOURNAL_START,
+           FS_KERNEL_START - 1, FS_JOURNAL_SLOT_SECTORS);
+    printf("  kernel          LBA %u-%u\n", FS_KERNEL_START, FS_KERNEL_START + FS_KERNEL_SECTORS - 1);
+    printf("  inode bitmap    LBA %u (+%u)\n", sb->inode_bitmap_start, sb->inode_bitmap_sectors);
+    printf("  block bitmap    LBA %u (+%u)\n", sb->block_bitmap_start, sb->block_bitmap_sectors);
+    printf("  inode table     LBA %u (+%u)\n", sb->inode_table_start, sb->inode_table_sectors);
+    printf("  data            LBA %u-%u\n", sb->data_start, sb->total_sectors - 1);
+    printf("inodes: %u of %u used\n", rep.nodes, sb->max_nodes);
+    printf("data:   %u of %u sectors used (%u%%)\n", rep.blocks, sb->total_sectors - sb->data_start,
+           (uint32_t)((uint64_t)rep.blocks * 100 / (sb->total_sectors - sb->data_start)));
+    printf("tree:   %u directories (%u indexed, largest %u entries), %u files, %llu bytes\n",
+           rep.dirs, rep.indexed_dirs, rep.largest_dir, rep.files, (unsigned long long)rep.file_bytes);
+    printf("        %u files fragmented\n", rep.fragmented);
+    if (rep.errors) printf("%u problems found; run 'mkpunixfs check'\n", rep.errors);
+
+    close_image();
+    return 0;
+}
+
+static int usage() {
+    fprintf(stderr,
+            "usage: mkpunixfs build <image> <dir> [size-MB]\n"
+            "       mkpunixfs check <image> [-r]\n"
+            "       mkpunixfs stat  <image>\n");
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 4 && strcmp(argv[1], "build") == 0) {
+        return cmd_build(argv[2], argv[3], argc > 4 ? (uint32_t)atoi(argv[4]) : 0);
+    }
+    if (argc >= 3 && strcmp(argv[1], "check") == 0) {
+        return cmd_check(argv[2], argc > 3 && strcmp(argv[3], "-r") == 0);
+    }
+    if (argc == 3 && strcmp(argv[1], "stat") == 0) {
+        return cmd_stat(argv[2]);
+    }
+    return usage();
+}